@@ -0,0 +1,202 @@
+#include"stdafx.h"
+#include"Autotuner.h"
+
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<sstream>
+#include<omp.h>
+
+#ifdef _MSC_VER
+#include<intrin.h>
+#else
+#include<cpuid.h>
+#endif
+
+//How many times each configuration is timed; the fastest time counts, to keep out one-off hiccups
+#define AUTOTUNE_RUNS 2
+
+static const char *scheduleNames[] = { "static", "dynamic", "guided" };
+
+//The profile file is read and written on every lookup and save, so several programs can share it
+Autotuner::Autotuner(std::string profilePath)
+{
+	this->profilePath = profilePath;
+}
+
+//Returns the key a profile is kept under: the CPU model, the engine's name and the grid's size (without ghost cells)
+std::string Autotuner::makeProfileKey(std::string engine, int rows, int cols)
+{
+	return getCpuModel() + "|" + engine + "|" + std::to_string(rows) + "x" + std::to_string(cols);
+}
+
+//Looks up the configuration saved under the given key; returns false if there isn't one
+bool Autotuner::findProfile(const std::string &key, TuningConfig &outConfig)
+{
+	std::map<std::string, TuningConfig> profiles = readProfiles();
+	auto profile = profiles.find(key);
+	if (profile == profiles.end())
+		return false;
+
+	outConfig = profile->second;
+	return true;
+}
+
+//Saves the configuration under the given key, replacing whatever was there
+void Autotuner::saveProfile(const std::string &key, const TuningConfig &config)
+{
+	std::map<std::string, TuningConfig> profiles = readProfiles();
+	profiles[key] = config;
+
+	std::ofstream file(profilePath, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Could not save the tuning profile to " << profilePath << "!" << std::endl;
+		return;
+	}
+	for (auto &profile : profiles)
+	{
+		file << profile.first << "\t" << profile.second.nThreads << "\t"
+			<< scheduleNames[static_cast<int>(profile.second.schedule)] << "\t" << profile.second.rowBlock << "\n";
+	}
+}
+
+//Finds the fastest configuration, starting from start and changing one setting at a time (see above)
+//benchmark must run the engine with the configuration it's given and return how long that took, in any unit, leaving
+//the grid the way it found it. Every thread count from getThreadCounts and every schedule is tried; the row block
+//sizes tried are the ones given.
+TuningConfig Autotuner::search(TuningConfig start, const std::vector<int> &rowBlocks,
+	const std::function<double(const TuningConfig&)> &benchmark)
+{
+	TuningConfig best = start;
+	double bestTime = timeConfig(best, benchmark);
+
+	for (int nThreads : getThreadCounts())
+	{
+		TuningConfig candidate = best;
+		candidate.nThreads = nThreads;
+		double candidateTime = timeConfig(candidate, benchmark);
+		if (candidateTime < bestTime)
+		{
+			best = candidate;
+			bestTime = candidateTime;
+		}
+	}
+
+	for (RowSchedule schedule : { RowSchedule::Static, RowSchedule::Dynamic, RowSchedule::Guided })
+	{
+		TuningConfig candidate = best;
+		candidate.schedule = schedule;
+		double candidateTime = timeConfig(candidate, benchmark);
+		if (candidateTime < bestTime)
+		{
+			best = candidate;
+			bestTime = candidateTime;
+		}
+	}
+
+	for (int rowBlock : rowBlocks)
+	{
+		TuningConfig candidate = best;
+		candidate.rowBlock = rowBlock;
+		double candidateTime = timeConfig(candidate, benchmark);
+		if (candidateTime < bestTime)
+		{
+			best = candidate;
+			bestTime = candidateTime;
+		}
+	}
+
+	return best;
+}
+
+//Returns the thread counts worth trying on this machine: the powers of 2 below the number of processors, and the
+//number of processors itself
+std::vector<int> Autotuner::getThreadCounts()
+{
+	std::vector<int> threadCounts;
+	int nProcessors = omp_get_num_procs();
+	for (int nThreads = 1; nThreads < nProcessors; nThreads *= 2)
+		threadCounts.push_back(nThreads);
+	threadCounts.push_back(nProcessors);
+	return threadCounts;
+}
+
+//Returns a configuration in words, for printing
+std::string Autotuner::describe(const TuningConfig &config)
+{
+	std::ostringstream description;
+	description << config.nThreads << (config.nThreads == 1 ? " thread, " : " threads, ")
+		<< scheduleNames[static_cast<int>(config.schedule)] << " schedule, " << config.rowBlock
+		<< (config.rowBlock == 1 ? " row at a time" : " rows at a time");
+	return description.str();
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Reads all the profiles in the file; lines that can't be read are skipped, and a missing file has no profiles
+std::map<std::string, TuningConfig> Autotuner::readProfiles()
+{
+	std::map<std::string, TuningConfig> profiles;
+	std::ifstream file(profilePath);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		//The key can have spaces in it (the CPU model does), so the fields are separated by tabs
+		std::istringstream fields(line);
+		std::string key, scheduleName;
+		TuningConfig config;
+		if (!std::getline(fields, key, '\t') || !(fields >> config.nThreads >> scheduleName >> config.rowBlock))
+			continue;
+
+		bool knownSchedule = false;
+		for (int schedule = 0; schedule < 3; ++schedule)
+		{
+			if (scheduleName == scheduleNames[schedule])
+			{
+				config.schedule = static_cast<RowSchedule>(schedule);
+				knownSchedule = true;
+			}
+		}
+		if (knownSchedule && config.nThreads > 0 && config.rowBlock > 0)
+			profiles[key] = config;
+	}
+	return profiles;
+}
+
+//Times a configuration AUTOTUNE_RUNS times and returns the fastest
+double Autotuner::timeConfig(const TuningConfig &config, const std::function<double(const TuningConfig&)> &benchmark)
+{
+	double fastest = benchmark(config);
+	for (int run = 1; run < AUTOTUNE_RUNS; ++run)
+	{
+		double runTime = benchmark(config);
+		if (runTime < fastest)
+			fastest = runTime;
+	}
+	return fastest;
+}
+
+//Returns the CPU's brand string, eg- "Intel(R) Core(TM) i7-6700 CPU @ 3.40GHz"
+std::string Autotuner::getCpuModel()
+{
+	//The brand string is 48 characters, 16 from each of 3 CPUID leaves
+	unsigned int registers[12] = {};
+	for (unsigned int leaf = 0; leaf < 3; ++leaf)
+	{
+#ifdef _MSC_VER
+		__cpuid(reinterpret_cast<int*>(registers + 4 * leaf), 0x80000002 + leaf);
+#else
+		__get_cpuid(0x80000002 + leaf, registers + 4 * leaf, registers + 4 * leaf + 1, registers + 4 * leaf + 2,
+			registers + 4 * leaf + 3);
+#endif
+	}
+
+	char brand[49] = {};
+	memcpy(brand, registers, 48);
+	std::string model = brand;
+	//It's padded with spaces on some CPUs
+	model.erase(0, model.find_first_not_of(' '));
+	model.erase(model.find_last_not_of(' ') + 1);
+	return model.empty() ? "Unknown CPU" : model;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include<functional>
+#include<map>
+#include<string>
+#include<vector>
+
+//How the rows (or blocks of rows) of a grid are handed out to the threads
+enum class RowSchedule { Static, Dynamic, Guided };
+
+//The settings an OpenMP engine runs with
+struct TuningConfig
+{
+	int nThreads;
+	RowSchedule schedule;
+	//The number of rows handed out at a time
+	int rowBlock;
+};
+
+/*Picks the fastest TuningConfig for an engine by timing it on the actual grid, and remembers it.
+The choices are kept in a profile file, one per line, keyed by the CPU model, the engine and the grid size, so that
+later runs on the same machine with the same grid start already tuned.
+
+The search only varies one setting at a time: it finds the best thread count with the engine's current schedule and
+row block, then the best schedule with that thread count, then the best row block with both of those. This takes a
+handful of timings instead of one for every combination.*/
+class Autotuner
+{
+public:
+	Autotuner(std::string profilePath = "SharksAndFish.tuning");
+	static std::string makeProfileKey(std::string engine, int rows, int cols);
+	bool findProfile(const std::string &key, TuningConfig &outConfig);
+	void saveProfile(const std::string &key, const TuningConfig &config);
+	TuningConfig search(TuningConfig start, const std::vector<int> &rowBlocks,
+		const std::function<double(const TuningConfig&)> &benchmark);
+	static std::vector<int> getThreadCounts();
+	static std::string describe(const TuningConfig &config);
+
+protected:
+	std::string profilePath;
+
+	std::map<std::string, TuningConfig> readProfiles();
+	double timeConfig(const TuningConfig &config, const std::function<double(const TuningConfig&)> &benchmark);
+	static std::string getCpuModel();
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include"stdafx.h"
+#include"CellPacking.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CELL_PACKING_SSE2
+#include<emmintrin.h>
+#endif
+
+//Packs nCells cells into one byte each
+//The values have to be in the range of a signed char, which all valid cell values are
+void CellPacking::packCells(const int *cells, int nCells, signed char *outPacked)
+{
+	int i = 0;
+
+#ifdef CELL_PACKING_SSE2
+	//Narrow 16 ints to 16 bytes with two rounds of saturating packs; nothing saturates since the values are in range
+	for (; i + 16 <= nCells; i += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i + 4));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i + 8));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i + 12));
+		__m128i packed = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outPacked + i), packed);
+	}
+#endif
+
+	//Whatever is left over (or everything, without SSE2)
+	for (; i < nCells; ++i)
+		outPacked[i] = static_cast<signed char>(cells[i]);
+}
+
+//Unpacks nCells cells that were packed with packCells
+void CellPacking::unpackCells(const signed char *packed, int nCells, int *outCells)
+{
+	int i = 0;
+
+#ifdef CELL_PACKING_SSE2
+	//Sign-extend 16 bytes to 16 ints by interleaving each value with its sign, first to 16 bits and then to 32 bits
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= nCells; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i));
+		__m128i byteSigns = _mm_cmplt_epi8(bytes, zero);
+		__m128i low = _mm_unpacklo_epi8(bytes, byteSigns);
+		__m128i high = _mm_unpackhi_epi8(bytes, byteSigns);
+		__m128i lowSigns = _mm_srai_epi16(low, 15);
+		__m128i highSigns = _mm_srai_epi16(high, 15);
+
+		__m128i *out = reinterpret_cast<__m128i*>(outCells + i);
+		_mm_storeu_si128(out, _mm_unpacklo_epi16(low, lowSigns));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low, lowSigns));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high, highSigns));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high, highSigns));
+	}
+#endif
+
+	//Whatever is left over (or everything, without SSE2)
+	for (; i < nCells; ++i)
+		outCells[i] = packed[i];
+}
\ No newline at end of file
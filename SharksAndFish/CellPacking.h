@@ -0,0 +1,10 @@
+#pragma once
+
+/*Converts cells between their in-memory form (one int each) and a packed form for sending between processes.
+Every cell value fits in a signed byte (fish are 1 to 10, sharks -1 to -20, water 0), so the packed form is one byte
+per cell, a quarter of the size. Where SSE2 is available, 16 cells are converted per instruction sequence.*/
+namespace CellPacking
+{
+	void packCells(const int *cells, int nCells, signed char *outPacked);
+	void unpackCells(const signed char *packed, int nCells, int *outCells);
+}
\ No newline at end of file
@@ -0,0 +1,365 @@
+#include"stdafx.h"
+#include"ClusterAnalysis.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<omp.h>
+
+#define N_THREADS 12
+
+ClusterAnalysis::ClusterAnalysis()
+{
+	nThreads = N_THREADS;
+}
+
+//Sets the number of threads the clusters are labelled on (N_THREADS by default), eg- to analyse the grid on as many
+//threads as the engine it's watching runs on
+void ClusterAnalysis::setThreadCount(int nThreads)
+{
+	this->nThreads = nThreads > 0 ? nThreads : 1;
+}
+
+int ClusterAnalysis::getThreadCount()
+{
+	return nThreads;
+}
+
+//Finds the clusters in the given grid, treating it as the whole ocean
+ClusterAnalysis::Summary ClusterAnalysis::analyseGrid(int **grid, int rows, int cols)
+{
+	this->grid = grid;
+	this->rows = rows;
+	this->cols = cols;
+
+	labelClusters(true);
+	countClusterSizes();
+
+	Summary summary;
+	memset(&summary, 0, sizeof(summary));
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			int cell = getCellIndex(row, col);
+			if (grid[row][col] != 0 && parent[cell] == cell)
+				addCluster(grid[row][col] > 0 ? summary.fish : summary.sharks, clusterSizes[cell]);
+		}
+	}
+	return summary;
+}
+
+//Finds the clusters in a grid that is split up by rows between the processes in comm, in order of rank; every
+//process has to call this with its own rows, and the clusters are joined up across the processes' edges (including
+//the last process' last row and the first process' first row)
+//Only process 0 gets the summary of the whole grid; the others get the one for their clusters that don't reach
+//their first or last row.
+ClusterAnalysis::Summary ClusterAnalysis::analyseGridMPI(int **grid, int rows, int cols, MPI_Comm comm)
+{
+	this->grid = grid;
+	this->rows = rows;
+	this->cols = cols;
+
+	int rank, nProcesses;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &nProcesses);
+
+	labelClusters(false);
+	countClusterSizes();
+
+	//Give the clusters touching the first or last row numbers starting from 0, and count the others straight away
+	//Each of the former is sent as its size, negated for sharks; the labels of the first and last row come after them
+	int nCols = cols - 2;
+	std::vector<int> edgeClusterIds(parent.size(), -1);
+	std::vector<long long> edgeData(1);
+	std::vector<long long> edgeLabels(2 * nCols, -1);
+	for (int edge = 0; edge < 2; ++edge)
+	{
+		int row = edge == 0 ? 1 : rows - 2;
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			if (grid[row][col] == 0)
+				continue;
+			int root = findRoot(getCellIndex(row, col));
+			if (edgeClusterIds[root] < 0)
+			{
+				edgeClusterIds[root] = static_cast<int>(edgeData.size()) - 1;
+				edgeData.push_back(grid[row][col] > 0 ? clusterSizes[root] : -clusterSizes[root]);
+			}
+			edgeLabels[edge * nCols + col - 1] = edgeClusterIds[root];
+		}
+	}
+	edgeData[0] = static_cast<long long>(edgeData.size()) - 1;
+	edgeData.insert(edgeData.end(), edgeLabels.begin(), edgeLabels.end());
+
+	Summary summary;
+	memset(&summary, 0, sizeof(summary));
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			int cell = getCellIndex(row, col);
+			if (grid[row][col] != 0 && parent[cell] == cell && edgeClusterIds[cell] < 0)
+				addCluster(grid[row][col] > 0 ? summary.fish : summary.sharks, clusterSizes[cell]);
+		}
+	}
+
+	//Add up the processes' summaries; everything is a sum except for the largest clusters
+	constexpr int nSummaryValues = sizeof(Summary) / sizeof(long long);
+	Summary totalSummary;
+	MPI_Reduce(&summary, &totalSummary, nSummaryValues, MPI_LONG_LONG, MPI_SUM, 0, comm);
+	long long largestClusters[2] = { summary.fish.largestCluster, summary.sharks.largestCluster };
+	long long totalLargestClusters[2];
+	MPI_Reduce(largestClusters, totalLargestClusters, 2, MPI_LONG_LONG, MPI_MAX, 0, comm);
+
+	//Collect the edge clusters and labels on process 0
+	int edgeDataSize = static_cast<int>(edgeData.size());
+	std::vector<int> edgeDataSizes(nProcesses), edgeDataOffsets(nProcesses);
+	MPI_Gather(&edgeDataSize, 1, MPI_INT, edgeDataSizes.data(), 1, MPI_INT, 0, comm);
+	std::vector<long long> allEdgeData;
+	if (rank == 0)
+	{
+		for (int i = 1; i < nProcesses; ++i)
+			edgeDataOffsets[i] = edgeDataOffsets[i - 1] + edgeDataSizes[i - 1];
+		allEdgeData.resize(edgeDataOffsets[nProcesses - 1] + edgeDataSizes[nProcesses - 1]);
+	}
+	MPI_Gatherv(edgeData.data(), edgeDataSize, MPI_LONG_LONG, allEdgeData.data(), edgeDataSizes.data(),
+		edgeDataOffsets.data(), MPI_LONG_LONG, 0, comm);
+
+	if (rank != 0)
+		return summary;
+
+	totalSummary.fish.largestCluster = totalLargestClusters[0];
+	totalSummary.sharks.largestCluster = totalLargestClusters[1];
+
+	//Number all the processes' edge clusters one after another, and join them with a union-find of their own
+	//edgeSizes holds each cluster's size, negated for sharks
+	std::vector<int> firstEdgeCluster(nProcesses + 1, 0);
+	for (int i = 0; i < nProcesses; ++i)
+		firstEdgeCluster[i + 1] = firstEdgeCluster[i] + static_cast<int>(allEdgeData[edgeDataOffsets[i]]);
+	std::vector<long long> edgeSizes(firstEdgeCluster[nProcesses]);
+	std::vector<int> edgeParent(firstEdgeCluster[nProcesses]);
+	for (int i = 0; i < nProcesses; ++i)
+	{
+		for (int cluster = 0; cluster < firstEdgeCluster[i + 1] - firstEdgeCluster[i]; ++cluster)
+		{
+			edgeSizes[firstEdgeCluster[i] + cluster] = allEdgeData[edgeDataOffsets[i] + 1 + cluster];
+			edgeParent[firstEdgeCluster[i] + cluster] = firstEdgeCluster[i] + cluster;
+		}
+	}
+
+	auto findEdgeRoot = [&edgeParent](int cluster)
+	{
+		while (edgeParent[cluster] != cluster)
+		{
+			edgeParent[cluster] = edgeParent[edgeParent[cluster]];
+			cluster = edgeParent[cluster];
+		}
+		return cluster;
+	};
+
+	//A process' last row touches the next process' first row
+	for (int i = 0; i < nProcesses; ++i)
+	{
+		int next = (i + 1) % nProcesses;
+		const long long *lastRow = allEdgeData.data() + edgeDataOffsets[i] + edgeDataSizes[i] - nCols;
+		const long long *nextFirstRow = allEdgeData.data() + edgeDataOffsets[next] + edgeDataSizes[next] - 2 * nCols;
+		for (int col = 0; col < nCols; ++col)
+		{
+			if (lastRow[col] < 0)
+				continue;
+			int cluster = firstEdgeCluster[i] + static_cast<int>(lastRow[col]);
+			for (int otherCol = col - 1; otherCol <= col + 1; ++otherCol)
+			{
+				long long otherLabel = nextFirstRow[(otherCol + nCols) % nCols];
+				if (otherLabel < 0)
+					continue;
+				int otherCluster = firstEdgeCluster[next] + static_cast<int>(otherLabel);
+				if ((edgeSizes[cluster] > 0) != (edgeSizes[otherCluster] > 0))
+					continue;
+
+				int root = findEdgeRoot(cluster), otherRoot = findEdgeRoot(otherCluster);
+				if (root != otherRoot)
+					edgeParent[std::max(root, otherRoot)] = std::min(root, otherRoot);
+			}
+		}
+	}
+
+	//Add each joined cluster's parts up into its root, and count it
+	std::vector<long long> joinedSizes(edgeSizes.size(), 0);
+	for (int cluster = 0; cluster < static_cast<int>(edgeSizes.size()); ++cluster)
+		joinedSizes[findEdgeRoot(cluster)] += edgeSizes[cluster];
+	for (int cluster = 0; cluster < static_cast<int>(edgeSizes.size()); ++cluster)
+	{
+		if (edgeParent[cluster] != cluster)
+			continue;
+		if (joinedSizes[cluster] > 0)
+			addCluster(totalSummary.fish, joinedSizes[cluster]);
+		else
+			addCluster(totalSummary.sharks, -joinedSizes[cluster]);
+	}
+
+	return totalSummary;
+}
+
+//Prints a summary to the console, one line per species, with the size distribution as "size range: count" pairs
+void ClusterAnalysis::printSummary(const Summary &summary, int generation)
+{
+	const char *names[2] = { "Fish schools", "Shark packs" };
+	const SpeciesSummary *speciesSummaries[2] = { &summary.fish, &summary.sharks };
+
+	std::cout << "Generation " << generation << ":\n";
+	for (int species = 0; species < 2; ++species)
+	{
+		const SpeciesSummary &speciesSummary = *speciesSummaries[species];
+		std::cout << names[species] << ": " << speciesSummary.nClusters << " (" << speciesSummary.nCells
+			<< " cells, largest " << speciesSummary.largestCluster << ")";
+		for (int bin = 0; bin < nClusterSizeBins; ++bin)
+		{
+			if (speciesSummary.sizeBins[bin] == 0)
+				continue;
+			std::cout << "  " << (1LL << bin);
+			if (bin > 0)
+				std::cout << "-" << (1LL << (bin + 1)) - 1;
+			std::cout << ": " << speciesSummary.sizeBins[bin];
+		}
+		std::cout << "\n";
+	}
+	std::cout << std::flush;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Labels the clusters in the grid, leaving each cell in parent pointing towards the root of its cluster
+//Every thread first labels its own band of rows, and then the bands are joined along their edges
+//If wrapRows is set, the first and last rows are neighbours as well; the columns always wrap around
+void ClusterAnalysis::labelClusters(bool wrapRows)
+{
+	int nRows = rows - 2;
+	parent.resize(static_cast<size_t>(nRows) * (cols - 2));
+
+#pragma omp parallel num_threads(nThreads)
+	{
+		//The runtime may give us fewer threads than asked for, so the bands are shared out between the ones we got
+		int nBands = omp_get_num_threads();
+		int thread = omp_get_thread_num();
+		int firstRow = 1 + static_cast<long long>(nRows) * thread / nBands;
+		int lastRow = 1 + static_cast<long long>(nRows) * (thread + 1) / nBands;
+
+		//Every cell is joined with the neighbours that come before it: the one on the left, and the 3 above it
+		//These are all in the band, so the threads never touch each other's part of parent
+		for (int row = firstRow; row < lastRow; ++row)
+		{
+			for (int col = 1; col < cols - 1; ++col)
+			{
+				int cell = getCellIndex(row, col);
+				parent[cell] = cell;
+				if (grid[row][col] == 0)
+					continue;
+
+				if (col > 1)
+					joinCells(row, col, row, col - 1);
+				if (row > firstRow)
+					joinWithRowAbove(row, col, row - 1);
+			}
+			//The first and last cells of the row are neighbours too
+			joinCells(row, 1, row, cols - 2);
+		}
+
+#pragma omp barrier
+#pragma omp single
+		{
+			for (int i = 1; i < nBands; ++i)
+			{
+				int bandFirstRow = 1 + static_cast<long long>(nRows) * i / nBands;
+				if (bandFirstRow > 1 && bandFirstRow < rows - 1)
+					joinRows(bandFirstRow, bandFirstRow - 1);
+			}
+			if (wrapRows)
+				joinRows(1, rows - 2);
+		}
+	}
+}
+
+//Joins every cell in row with its neighbours in rowAbove (which doesn't have to be the row right above it, so the
+//last row can be joined with the first one)
+void ClusterAnalysis::joinRows(int row, int rowAbove)
+{
+	for (int col = 1; col < cols - 1; ++col)
+	{
+		if (grid[row][col] != 0)
+			joinWithRowAbove(row, col, rowAbove);
+	}
+}
+
+//Joins a cell with its 3 neighbours in rowAbove
+void ClusterAnalysis::joinWithRowAbove(int row, int col, int rowAbove)
+{
+	for (int iCol = col - 1; iCol <= col + 1; ++iCol)
+	{
+		//Wrap around the edges
+		int otherCol = iCol == 0 ? cols - 2 : (iCol == cols - 1 ? 1 : iCol);
+		joinCells(row, col, rowAbove, otherCol);
+	}
+}
+
+//Puts two cells in the same cluster if they have the same species in them
+//The root with the higher index is made to point to the other one
+void ClusterAnalysis::joinCells(int row, int col, int otherRow, int otherCol)
+{
+	int value = grid[row][col], otherValue = grid[otherRow][otherCol];
+	if (!((value > 0 && otherValue > 0) || (value < 0 && otherValue < 0)))
+		return;
+
+	int root = findRoot(getCellIndex(row, col));
+	int otherRoot = findRoot(getCellIndex(otherRow, otherCol));
+	if (root != otherRoot)
+		parent[std::max(root, otherRoot)] = std::min(root, otherRoot);
+}
+
+//Returns the root of a cell's cluster, halving the path to it on the way
+int ClusterAnalysis::findRoot(int cell)
+{
+	while (parent[cell] != cell)
+	{
+		parent[cell] = parent[parent[cell]];
+		cell = parent[cell];
+	}
+	return cell;
+}
+
+//Returns the index of a cell in parent and clusterSizes; row and col include the ghost cells
+int ClusterAnalysis::getCellIndex(int row, int col)
+{
+	return (row - 1) * (cols - 2) + col - 1;
+}
+
+//Counts the cells in each cluster into clusterSizes at the cluster's root, and points every cell straight at its root
+void ClusterAnalysis::countClusterSizes()
+{
+	clusterSizes.assign(parent.size(), 0);
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			if (grid[row][col] == 0)
+				continue;
+			int cell = getCellIndex(row, col);
+			parent[cell] = findRoot(cell);
+			++clusterSizes[parent[cell]];
+		}
+	}
+}
+
+//Adds a cluster of the given size to a summary
+void ClusterAnalysis::addCluster(SpeciesSummary &summary, long long size)
+{
+	int bin = 0;
+	while (bin < nClusterSizeBins - 1 && (size >> (bin + 1)) > 0)
+		++bin;
+
+	++summary.nClusters;
+	summary.nCells += size;
+	summary.largestCluster = std::max(summary.largestCluster, size);
+	++summary.sizeBins[bin];
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include<mpi.h>
+#include<vector>
+
+//The number of bins in a cluster size distribution; bin i counts the clusters of 2^i to 2^(i + 1) - 1 cells
+constexpr int nClusterSizeBins = 32;
+
+/*Finds the fish schools and shark packs in a grid: groups of fish (or of sharks) connected through any of the 8
+neighbouring cells, wrapping around the edges of the grid like the ghost cells do. Only a summary of them is kept,
+with the number of clusters, their total and largest size, and how many there are of each size.
+
+The clusters are labelled with a union-find over the cells. The rows are split into one band per thread, each thread
+labels its own band, and the bands are then joined along their edges. With MPI, every process labels its own rows
+like that, and sends the labels of its first and last row, along with the sizes of the clusters that touch them, to
+process 0, which joins them up; the clusters that don't touch them are only counted.*/
+class ClusterAnalysis
+{
+public:
+	struct SpeciesSummary
+	{
+		long long nClusters, nCells, largestCluster;
+		long long sizeBins[nClusterSizeBins];
+	};
+
+	struct Summary
+	{
+		SpeciesSummary fish, sharks;
+	};
+
+	ClusterAnalysis();
+	void setThreadCount(int nThreads);
+	int getThreadCount();
+	Summary analyseGrid(int **grid, int rows, int cols);
+	Summary analyseGridMPI(int **grid, int rows, int cols, MPI_Comm comm);
+	static void printSummary(const Summary &summary, int generation);
+
+protected:
+	//The number of threads the grid's rows are shared out between, one band each
+	int nThreads;
+	//The grid being analysed; rows and cols include the ghost cells, which are not looked at
+	int **grid;
+	int rows, cols;
+	//The union-find forest, one entry per actual cell (row by row), and the number of cells in each cluster
+	std::vector<int> parent, clusterSizes;
+
+	void labelClusters(bool wrapRows);
+	void joinRows(int row, int rowAbove);
+	void joinWithRowAbove(int row, int col, int rowAbove);
+	void joinCells(int row, int col, int otherRow, int otherCol);
+	int findRoot(int cell);
+	int getCellIndex(int row, int col);
+	void countClusterSizes();
+	static void addCluster(SpeciesSummary &summary, long long size);
+};
\ No newline at end of file
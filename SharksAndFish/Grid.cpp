@@ -1,17 +1,50 @@
 #include"stdafx.h"
 #include"Grid.h"
 #include"Utils.h"
-
+#include"HistoryLog.h"
+#include"ClusterAnalysis.h"
+#include"TelemetryServer.h"
+#include"GridArena.h"
+#include"Snapshot.h"
+#include"InitialState.h"
+#include"SteadyStateDetector.h"
+
+#include<algorithm>
 #include<iostream>
+#include<cstring>
 #include<ctime>
+#include<utility>
+#include<vector>
 #include<opencv2\opencv.hpp>
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define GRID_STREAMING_STORES
+#include<emmintrin.h>
+#endif
+
+//The colours showGridAsImage uses for each kind of cell, as blue, green, red
+static const unsigned char waterPixel[3] = { 255, 153, 153 };	//light blue
+static const unsigned char fishPixel[3] = { 102, 0, 204 };		//maroon
+static const unsigned char sharkPixel[3] = { 51, 255, 255 };	//yellow
+
 //Instantiates a grid with the given number of rows and columns
-Grid::Grid(int rows, int cols)
+//In low memory mode, only the currentGrid is allocated and generations are calculated in place
+Grid::Grid(int rows, int cols, bool lowMemory)
 {
 	//Add 2 extra rows and columns to make space for ghost cells
 	this->rows = rows + 2;
 	this->cols = cols + 2;
+	this->lowMemory = lowMemory;
+	historyWriter = nullptr;
+	clusterAnalysis = nullptr;
+	clusterAnalysisInterval = 0;
+	generation = 0;
+	telemetryServer = nullptr;
+	telemetryInterval = 0;
+	steadyStateDetector = nullptr;
+	randomSharkDeaths = true;
+	layoutCounts = nullptr;
+	streamingStores = false;
 
 	//Allocates memory for the two grid variables
 	allocateMemoryToGridVariables();
@@ -22,13 +55,7 @@ Grid::Grid(int rows, int cols)
 
 Grid::~Grid()
 {
-	for (int i = 0; i < rows; ++i)
-	{
-		delete[] currentGrid[i];
-		delete[] nextCalculatedGrid[i];
-	}
-	delete[] currentGrid;
-	delete[] nextCalculatedGrid;
+	delete arena;
 }
 
 //Prints the contents of the current grid to the console in the form of characters
@@ -73,6 +100,22 @@ void Grid::printStatsToConsole()
 	std::cout << "\nNumber of water cells: " << waterCount << std::endl;
 }
 
+//Prints the stats collected by goToNextGeneration: the count of shark and fish, and how many there are of each age
+void Grid::printStatsToConsole(const GenerationOutputs &outputs)
+{
+	const GenerationCounts &counts = outputs.counts;
+	std::cout << "Number of sharks: " << counts.sharkCount << "\nNumber of fish: " << counts.fishCount;
+	std::cout << "\nNumber of water cells: " << counts.waterCount;
+
+	std::cout << "\nFish by age:";
+	for (int age = 1; age <= maxFishAge; ++age)
+		std::cout << " " << counts.fishAges[age];
+	std::cout << "\nSharks by age:";
+	for (int age = 1; age <= maxSharkAge; ++age)
+		std::cout << " " << counts.sharkAges[age];
+	std::cout << std::endl;
+}
+
 //Runs the grid according to the rules for nIterations, and returns the time it took to complete
 float Grid::runTest(int nIterations)
 {
@@ -81,13 +124,25 @@ float Grid::runTest(int nIterations)
 	{
 		calculateNextGridState();
 		goToNextGridState();
+		//Stop early, or skip whole cycles, once the detector knows how the run ends
+		if (steadyStateDetector != nullptr)
+			nIterations = i + 1 + steadyStateDetector->skipAhead(nIterations - i - 1);
 	}
 	return clock() - startTime;
 }
 
 //Equates the currentGrid to the nextCalculatedGrid
+//In low memory mode the next state was already written into the currentGrid, so there is nothing to copy
 void Grid::goToNextGridState()
 {
+	auto copyStart = std::chrono::steady_clock::now();
+
+	if (lowMemory)
+	{
+		processGeneration(copyStart);
+		return;
+	}
+
 	//In the for loops, the first and last row and column are excluded because they are ghost cells, which are not copied
 	for (int row = 1; row < rows - 1; ++row)
 	{
@@ -96,61 +151,48 @@ void Grid::goToNextGridState()
 			currentGrid[row][col] = nextCalculatedGrid[row][col];
 		}
 	}
+
+	processGeneration(copyStart);
+}
+
+//Calculates the next generation and makes it the current one, collecting the counts and the image outputs asks for on
+//the way. This takes one pass over the grid where calculateNextGridState, goToNextGridState, printStatsToConsole and
+//showGridAsImage take one each: every row's outputs are collected as soon as it has been calculated, while it is
+//still in the cache, and the new generation is made current by swapping the grids instead of copying it over.
+void Grid::goToNextGeneration(GenerationOutputs &outputs)
+{
+	prepareOutputs(outputs);
+	calculateNextGridState(&outputs);
+
+	//Every cell of the nextCalculatedGrid but the ghost cells has just been written, and the ghost cells are filled in
+	//before they're next read, so the grids can simply trade places
+	auto copyStart = std::chrono::steady_clock::now();
+	if (!lowMemory)
+		std::swap(currentGrid, nextCalculatedGrid);
+
+	processGeneration(copyStart);
 }
 
 //Evaluates the rules of the celluar automata and puts values in the nextCalculatedGrid based on them
-void Grid::calculateNextGridState()
+//If outputs is given, they are collected for the new generation as well (see goToNextGeneration)
+void Grid::calculateNextGridState(GenerationOutputs *outputs)
 {
 	updateGhostCells();
+	outputs = prepareLayoutHash(outputs);
+	GenerationCounts *counts = outputs != nullptr ? &outputs->counts : nullptr;
 
-	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
-	//In the for loops, the first and last row and column are excluded because they are ghost cells
-	for (int row = 1; row < rows - 1; ++row)
+	if (lowMemory)
 	{
-		for (int col = 1; col < cols - 1; ++col)
-		{
-			//Get the neighbours' counts
-			getNeighbourCount(row, col, nSharkNeighbours, nFishNeighbours);
-			nBreedingFish = nFishNeighbours % 10;
-			nBreedingSharks = nSharkNeighbours % 10;
-			nFishNeighbours /= 10;
-			nSharkNeighbours /= 10;
-
-			if (currentGrid[row][col] == 0)	//cell is empty
-			{
-				//Breeding Rule
-				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
-					nextCalculatedGrid[row][col] = 1;	//spawn fish
-				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
-					nextCalculatedGrid[row][col] = -1;	//spawn shark
-				else	//nothing happens; cell stays empty
-					nextCalculatedGrid[row][col] = 0;
-
-			}
-			else if (currentGrid[row][col] > 0)	//cell has a fish
-			{
-				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
-					nextCalculatedGrid[row][col] = 0;
-				else if (nFishNeighbours == 8)	//overpopulation; fish dies
-					nextCalculatedGrid[row][col] = 0;
-				else if (currentGrid[row][col] == 10)	//max age reached; fish dies
-					nextCalculatedGrid[row][col] = 0;
-				else	//nothing happens to the fish 
-					nextCalculatedGrid[row][col] = ++currentGrid[row][col];	//increment fish's age
-			}
-			else	//cell has a shark
-			{
-				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
-					nextCalculatedGrid[row][col] = 0;
-				else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
-					nextCalculatedGrid[row][col] = 0;
-				else if (currentGrid[row][col] == -20)	//reached max age; shark dies
-					nextCalculatedGrid[row][col] = 0;
-				else	//nothing happens, shark survives; increment age
-					nextCalculatedGrid[row][col] = --currentGrid[row][col];
-			}
-		}
+		//Two rows' worth of old values; the ghost rows already hold the old values of the rows they wrap around to
+		std::vector<int> rowBuffers(2 * cols);
+		calculateRowsInPlace(1, rows - 1, currentGrid[0], currentGrid[rows - 1], rowBuffers.data(),
+			randomSharkDeaths ? 32 : 0, outputs, counts);
+		return;
 	}
+
+	//Five rows' worth of encoded cells; see calculateRows
+	std::vector<unsigned short> rowBuffers(5 * cols);
+	calculateRows(1, rows - 1, rowBuffers.data(), randomSharkDeaths ? 32 : 0, outputs, counts);
 }
 
 //Shows the grid as an image using OpenCV (displays the image in a new window)
@@ -183,18 +225,292 @@ void Grid::showGridAsImage(std::string additionalInfo)
 	cv::waitKey(0);
 }
 
+//Shows the image collected by goToNextGeneration using OpenCV (displays the image in a new window)
+void Grid::showGridAsImage(const GenerationOutputs &outputs, std::string additionalInfo)
+{
+	using namespace cv;
+
+	//The Mat only wraps the pixels; imshow doesn't change them
+	Mat gridImage = Mat(outputs.imageHeight, outputs.imageWidth, CV_8UC3, const_cast<unsigned char*>(outputs.image.data()));
+
+	cv::imshow("Sharks and Fish" + std::string(" ") + additionalInfo, gridImage);
+	cv::waitKey(0);
+}
+
+//Starts recording every generation to the given writer, beginning with the current one, until it's called again with
+//nullptr; the writer must stay alive until then
+//Generations are recorded in goToNextGridState, so this works for every grid that goes through it
+void Grid::recordHistory(HistoryWriter *writer)
+{
+	historyWriter = writer;
+	if (historyWriter != nullptr)
+		historyWriter->recordGeneration(currentGrid, rows, cols);
+}
+
+//Starts analysing the clusters of fish and sharks every interval generations with the given analysis, printing a
+//summary each time, until it's called again with nullptr
+void Grid::analyseClusters(ClusterAnalysis *analysis, int interval)
+{
+	clusterAnalysis = analysis;
+	clusterAnalysisInterval = interval > 0 ? interval : 1;
+}
+
+//Sets whether calculateNextGridState writes the nextCalculatedGrid with non-temporal (streaming) stores, which go
+//around the cache instead of evicting the rows still being read from it. This pays off on grids much bigger than the
+//cache, when the new generation isn't read again right away; the copy in goToNextGridState reads it straight back,
+//so it's mostly useful with goToNextGeneration. Without SSE2, normal stores are used either way.
+void Grid::setStreamingStores(bool streamingStores)
+{
+#ifdef GRID_STREAMING_STORES
+	this->streamingStores = streamingStores;
+#endif
+}
+
+//Returns what kind of pages the grids are kept on
+GridArena::PageKind Grid::getPageKind()
+{
+	return arena->getPageKind();
+}
+
+//Returns the number of generations calculated since the grid was made or restarted; whole cycles skipped by a steady
+//state detector aren't counted
+int Grid::getGeneration()
+{
+	return generation;
+}
+
+//Starts publishing every interval generations to the given telemetry server, until it's called again with nullptr
+//Publishing counts every cell on this thread, so on big grids an interval of more than 1 keeps it from slowing the
+//run down; the server also skips it until someone has asked it for something.
+void Grid::publishTelemetry(TelemetryServer *server, int interval)
+{
+	telemetryServer = server;
+	telemetryInterval = interval > 0 ? interval : 1;
+	lastGenerationEnd = std::chrono::steady_clock::now();
+}
+
+//Starts looking at every generation with the given detector, beginning with the current one, until it's called again
+//with nullptr; runTest then stops once there's nothing left alive, and skips the whole cycles left once the grid
+//repeats (see SteadyStateDetector)
+void Grid::detectSteadyState(SteadyStateDetector *detector)
+{
+	steadyStateDetector = detector;
+	if (steadyStateDetector != nullptr)
+	{
+		steadyStateDetector->reset();
+		steadyStateDetector->observe(currentGrid, rows, cols, generation, randomSharkDeaths);
+	}
+}
+
+//Sets whether sharks die of random causes (they do by default); without that, the same grid always leads to the same
+//generations, so a steady state detector can find cycles
+void Grid::setRandomSharkDeaths(bool randomSharkDeaths)
+{
+	this->randomSharkDeaths = randomSharkDeaths;
+}
+
+//Writes the current grid to a compressed snapshot file (see SnapshotWriter); returns false if it couldn't be written
+bool Grid::saveSnapshot(std::string filePath)
+{
+	SnapshotWriter writer;
+	return writer.write(filePath, currentGrid, rows, cols);
+}
+
+//Replaces the current grid with the one in a snapshot file, which has to be the same size
+//Returns false (leaving the grid as it was, unless the file was damaged part way through) if it couldn't be loaded
+bool Grid::loadSnapshot(std::string filePath)
+{
+	SnapshotReader reader(filePath);
+	if (!reader.isValid())
+		return false;
+	if (reader.getRows() != rows - 2 || reader.getCols() != cols - 2)
+	{
+		std::cout << "The snapshot in " << filePath << " is " << reader.getRows() << " x " << reader.getCols()
+			<< ", not the size of the grid!" << std::endl;
+		return false;
+	}
+	if (!reader.readRows(0, rows - 2, currentGrid))
+	{
+		std::cout << "The snapshot in " << filePath << " is damaged!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//Replaces the current grid with one made from a density map or a pattern (see InitialState)
+//Returns false if the file couldn't be read
+bool Grid::loadInitialState(InitialState &state)
+{
+	return state.fill(currentGrid, rows, cols);
+}
+
+//Starts over with a new random grid of the given size, as if it had just been made with those arguments and filled with
+//initGrid(sharkPercent, fishPercent), but in the memory of the old one when it fits (see GridArena::reshape)
+//Whatever was recording, analysing or publishing the old grid is let go of, since it was set up for that grid.
+void Grid::restart(int rows, int cols, int sharkPercent, int fishPercent, bool lowMemory)
+{
+	this->rows = rows + 2;
+	this->cols = cols + 2;
+	this->lowMemory = lowMemory;
+	historyWriter = nullptr;
+	clusterAnalysis = nullptr;
+	telemetryServer = nullptr;
+	steadyStateDetector = nullptr;
+	randomSharkDeaths = true;
+	layoutCounts = nullptr;
+	generation = 0;
+
+	if (arena->reshape(lowMemory ? 1 : 2, this->rows, this->cols))
+	{
+		currentGrid = arena->getGrid(0);
+		nextCalculatedGrid = lowMemory ? nullptr : arena->getGrid(1);
+	}
+	else
+	{
+		delete arena;
+		allocateMemoryToGridVariables();
+	}
+
+	initGrid(sharkPercent, fishPercent);
+}
+
 //======PRIVATE MEMBERS===========================================================================
 
 //Allocates new memory to currentGrid and nextCalculatedGrid based on this Grid's rows and cols
+//Both grids are kept in one GridArena, on huge pages if the grid is big enough and the system has them
 void Grid::allocateMemoryToGridVariables()
 {
-	currentGrid = new int*[rows];
-	for (int row = 0; row < rows; ++row)
-		currentGrid[row] = new int[cols];
+	//The nextCalculatedGrid is not needed in low memory mode
+	arena = new GridArena(lowMemory ? 1 : 2, rows, cols);
+	currentGrid = arena->getGrid(0);
+	nextCalculatedGrid = lowMemory ? nullptr : arena->getGrid(1);
+}
+
+//Called with every new generation in the currentGrid, to record it, analyse it and publish it if that has been asked for
+//copyStart is when goToNextGridState started; everything since the last generation was processed until then is
+//counted as calculating
+void Grid::processGeneration(std::chrono::steady_clock::time_point copyStart)
+{
+	++generation;
+	auto analysisStart = std::chrono::steady_clock::now();
+
+	if (historyWriter != nullptr)
+		historyWriter->recordGeneration(currentGrid, rows, cols);
+
+	if (clusterAnalysis != nullptr && generation % clusterAnalysisInterval == 0)
+		ClusterAnalysis::printSummary(clusterAnalysis->analyseGrid(currentGrid, rows, cols), generation);
+
+	//The layout hash comes from the kernel when it could collect it, and the grid is only hashed again when it couldn't
+	if (steadyStateDetector != nullptr && layoutCounts != nullptr)
+		steadyStateDetector->observe(layoutCounts->layoutHash, { layoutCounts->sharkCount, layoutCounts->fishCount },
+			generation, randomSharkDeaths);
+	else if (steadyStateDetector != nullptr)
+		steadyStateDetector->observe(currentGrid, rows, cols, generation, randomSharkDeaths);
+	layoutCounts = nullptr;
+
+	if (telemetryServer != nullptr)
+	{
+		if (generation % telemetryInterval == 0)
+		{
+			auto analysisEnd = std::chrono::steady_clock::now();
+			typedef std::chrono::duration<double, std::milli> Milliseconds;
+			double phaseMilliseconds[nTelemetryPhases];
+			phaseMilliseconds[calculatePhase] = Milliseconds(copyStart - lastGenerationEnd).count();
+			phaseMilliseconds[copyPhase] = Milliseconds(analysisStart - copyStart).count();
+			phaseMilliseconds[analysisPhase] = Milliseconds(analysisEnd - analysisStart).count();
+			telemetryServer->publish(currentGrid, rows, cols, generation, phaseMilliseconds);
+		}
+		//The timings are always for the generation published, not for all the ones since the last
+		lastGenerationEnd = std::chrono::steady_clock::now();
+	}
+}
+
+//Zeroes the counts and sizes the image for a generation of this grid, for whichever of them outputs asks for
+void Grid::prepareOutputs(GenerationOutputs &outputs)
+{
+	outputs.collectLayoutHash = steadyStateDetector != nullptr;
+	if (outputs.collectCounts || outputs.collectLayoutHash)
+		outputs.counts = GenerationCounts();
+
+	if (outputs.collectImage)
+	{
+		outputs.imageScale = std::max(outputs.imageScale, 1);
+		outputs.imageWidth = (cols - 2 + outputs.imageScale - 1) / outputs.imageScale;
+		outputs.imageHeight = (rows - 2 + outputs.imageScale - 1) / outputs.imageScale;
+		outputs.image.resize(3 * static_cast<size_t>(outputs.imageWidth) * outputs.imageHeight);
+	}
+}
+
+//Called by calculateNextGridState before calculating a generation, so the layout hash the steady state detector needs
+//is collected on the way: returns the outputs to collect into, which are the grid's own if none were given and a
+//detector is watching, and keeps track of where the hash ends up for processGeneration
+GenerationOutputs *Grid::prepareLayoutHash(GenerationOutputs *outputs)
+{
+	if (steadyStateDetector != nullptr && outputs == nullptr)
+	{
+		steadyStateOutputs.collectCounts = steadyStateOutputs.collectImage = false;
+		prepareOutputs(steadyStateOutputs);
+		outputs = &steadyStateOutputs;
+	}
+	layoutCounts = outputs != nullptr && outputs->collectLayoutHash ? &outputs->counts : nullptr;
+	return outputs;
+}
+
+//Collects the outputs for a row that has just been calculated (cells is the row in its new state, including the ghost
+//cells): adds its cells to counts, and writes its pixels to the image if it's at the top of a row of pixels
+//Different rows can be collected at the same time as long as each thread has its own counts.
+void Grid::collectRow(const int *cells, int row, GenerationOutputs &outputs, GenerationCounts &counts)
+{
+	if (outputs.collectCounts || outputs.collectLayoutHash)
+	{
+		//Count how many cells have each value (from -maxSharkAge to maxFishAge) without branching, then add those up
+		int valueCounts[maxSharkAge + 1 + maxFishAge] = {};
+		int *waterCount = valueCounts + maxSharkAge;
+		for (int col = 1; col < cols - 1; ++col)
+			++waterCount[cells[col]];
+
+		counts.waterCount += *waterCount;
+		for (int age = 1; age <= maxFishAge; ++age)
+		{
+			counts.fishCount += waterCount[age];
+			counts.fishAges[age] += waterCount[age];
+		}
+		for (int age = 1; age <= maxSharkAge; ++age)
+		{
+			counts.sharkCount += waterCount[-age];
+			counts.sharkAges[age] += waterCount[-age];
+		}
+	}
+
+	if (outputs.collectLayoutHash)
+		counts.layoutHash += SteadyStateDetector::hashRow(cells, row, cols);
+
+	if (outputs.collectImage && (row - 1) % outputs.imageScale == 0)
+	{
+		//Indexed by the sign of the cell plus 1
+		const unsigned char *colours[3] = { sharkPixel, waterPixel, fishPixel };
+		unsigned char *pixel = outputs.image.data() + 3 * static_cast<size_t>((row - 1) / outputs.imageScale) * outputs.imageWidth;
+		for (int col = 1; col < cols - 1; col += outputs.imageScale, pixel += 3)
+		{
+			const unsigned char *colour = colours[(cells[col] > 0) - (cells[col] < 0) + 1];
+			pixel[0] = colour[0];
+			pixel[1] = colour[1];
+			pixel[2] = colour[2];
+		}
+	}
+}
 
-	nextCalculatedGrid = new int*[rows];
-	for (int row = 0; row < rows; ++row)
-		nextCalculatedGrid[row] = new int[cols];
+//Adds the given counts to total
+void Grid::addCounts(GenerationCounts &total, const GenerationCounts &counts)
+{
+	total.sharkCount += counts.sharkCount;
+	total.fishCount += counts.fishCount;
+	total.waterCount += counts.waterCount;
+	total.layoutHash += counts.layoutHash;
+	for (int age = 0; age <= maxFishAge; ++age)
+		total.fishAges[age] += counts.fishAges[age];
+	for (int age = 0; age <= maxSharkAge; ++age)
+		total.sharkAges[age] += counts.sharkAges[age];
 }
 
 //Initializes the grid randomly
@@ -212,6 +528,9 @@ void Grid::initGrid()
 		}
 	}
 
+	if (lowMemory)
+		return;
+
 	for (int row = 1; row < rows - 1; ++row)
 	{
 		for (int col = 1; col < cols - 1; ++col)
@@ -243,6 +562,9 @@ void Grid::initGrid(int sharkPercent, int fishPercent)
 		}
 	}
 
+	if (lowMemory)
+		return;
+
 	for (int row = 1; row < rows - 1; ++row)
 	{
 		for (int col = 1; col < cols - 1; ++col)
@@ -285,6 +607,13 @@ void Grid::updateGhostCells()
 //eg - If there are 5 fish neighbours out of which 3 are of breeding age, the value of outFishCount will be stored as
 //10 * 5 + 3 = 53. This implies that the first digit will always be equal to or greater than the second.
 void Grid::getNeighbourCount(int row, int col, int &outSharkCount, int &outFishCount)
+{
+	getNeighbourCount(currentGrid, row, col, outSharkCount, outFishCount);
+}
+
+//Same as above, but counts the neighbours in the given grid instead of the currentGrid
+//Used by engines that do not always keep the generation being read in currentGrid
+void Grid::getNeighbourCount(int **grid, int row, int col, int &outSharkCount, int &outFishCount)
 {
 	outFishCount = 0;
 	outSharkCount = 0;
@@ -296,7 +625,7 @@ void Grid::getNeighbourCount(int row, int col, int &outSharkCount, int &outFishC
 	{
 		for (int iCol = col - 1; iCol <= col + 1; ++iCol)
 		{
-			currentValue = currentGrid[iRow][iCol];
+			currentValue = grid[iRow][iCol];
 			if (currentValue > 0)	//fish
 			{
 				++outFishCount;
@@ -313,19 +642,226 @@ void Grid::getNeighbourCount(int row, int col, int &outSharkCount, int &outFishC
 	}
 
 	//Eliminate the extra value coming from the cell itself
-	if (currentGrid[row][col] > 0)	//fish
+	if (grid[row][col] > 0)	//fish
 	{
 		--outFishCount;
-		if (currentGrid[row][col] >= 2)	//breeding age
+		if (grid[row][col] >= 2)	//breeding age
 			--breedingFishCount;
 	}
-	else if (currentGrid[row][col] < 0)	//shark
+	else if (grid[row][col] < 0)	//shark
 	{
 		--outSharkCount;
-		if (currentGrid[row][col] <= -3)	//breeding age
+		if (grid[row][col] <= -3)	//breeding age
 			--breedingSharkCount;
 	}
 
 	outFishCount = (outFishCount * 10) + breedingFishCount;
 	outSharkCount = (outSharkCount * 10) + breedingSharkCount;
+}
+
+//Applies the rules to rows firstRow to lastRow - 1 of the currentGrid, writing each cell's next state over its current one
+//rowAbove and rowBelow must hold the old values of the rows just outside the range; they can't be read from the
+//currentGrid itself if someone else may be overwriting them at the same time. rowBuffers needs space for 2 rows.
+//A shark dies of random causes with a chance of 1 in sharkDeathOdds, or never if it's 0.
+//The cells see the same neighbour values they would with two grids: cells that were already updated show their new
+//age if they survived (the two grid version ages them in place in the currentGrid as well) and their old value
+//otherwise, and cells not updated yet show their old value. This only needs the old values of the row above, and of
+//the current row, which are kept in rowBuffers.
+//If outputs is given, each row is collected into it (with its counts going to counts) once it has been calculated.
+void Grid::calculateRowsInPlace(int firstRow, int lastRow, int *rowAbove, int *rowBelow, int *rowBuffers, int sharkDeathOdds,
+	GenerationOutputs *outputs, GenerationCounts *counts)
+{
+	int *rowAboveValues = rowAbove;
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		//Keep the row's old values (including the ghost columns) in whichever buffer isn't holding the row above
+		int *rowValues = rowBuffers + ((row - firstRow) % 2) * cols;
+		memcpy(rowValues, currentGrid[row], cols * sizeof(int));
+
+		//The three rows around the cell, as seen by the rules
+		int *neighbourhood[3] = { rowAboveValues, rowValues, row + 1 < lastRow ? currentGrid[row + 1] : rowBelow };
+
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			//Get the neighbours' counts
+			getNeighbourCount(neighbourhood, 1, col, nSharkNeighbours, nFishNeighbours);
+			nBreedingFish = nFishNeighbours % 10;
+			nBreedingSharks = nSharkNeighbours % 10;
+			nFishNeighbours /= 10;
+			nSharkNeighbours /= 10;
+
+			int currentValue = rowValues[col];
+			int nextValue;
+			if (currentValue == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					nextValue = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					nextValue = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					nextValue = 0;
+			}
+			else if (currentValue > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					nextValue = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					nextValue = 0;
+				else if (currentValue == 10)	//max age reached; fish dies
+					nextValue = 0;
+				else	//nothing happens to the fish
+					nextValue = currentValue + 1;	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					nextValue = 0;
+				else if (sharkDeathOdds > 0 && Utils::getRandomNumber(1, sharkDeathOdds) == 1)	//random causes; shark dies. bad luck.
+					nextValue = 0;
+				else if (currentValue == -20)	//reached max age; shark dies
+					nextValue = 0;
+				else	//nothing happens, shark survives; increment age
+					nextValue = currentValue - 1;
+			}
+
+			currentGrid[row][col] = nextValue;
+			//What the cells after this one see (see above)
+			if (currentValue != 0 && nextValue != 0)
+				rowValues[col] = nextValue;
+		}
+
+		if (outputs != nullptr)
+			collectRow(currentGrid[row], row, *outputs, *counts);
+
+		rowAboveValues = rowValues;
+	}
+}
+
+//Applies the rules to rows firstRow to lastRow - 1, putting the results in the nextCalculatedGrid
+//rowBuffers needs space for 5 rows. A shark dies of random causes with a chance of 1 in sharkDeathOdds, or never if
+//it's 0.
+//The neighbours are counted on encoded cells (see encodeCell): every column's 3 cells are added up once per row, and
+//each cell's neighbourhood is then the sum of 3 of those column sums minus the cell itself, which gives all four
+//counts at once. The cells of the row above and the one to the left have already been calculated, and have been aged
+//in place if they survived, so their encoded values are taken after that happens, as getNeighbourCount would see them.
+//With streamingStores set, each row's results are put together in a small buffer, which stays in the cache, and then
+//written out with non-temporal stores (see setStreamingStores).
+//If outputs is given, each row is collected into it (with its counts going to counts) once it has been calculated.
+void Grid::calculateRows(int firstRow, int lastRow, unsigned short *rowBuffers, int sharkDeathOdds,
+	GenerationOutputs *outputs, GenerationCounts *counts)
+{
+	//The row above as it is now, the current row as it was, the row below, the current row as it is now, and the
+	//column sums
+	unsigned short *encodedAbove = rowBuffers, *encodedRow = rowBuffers + cols, *encodedBelow = rowBuffers + 2 * cols;
+	unsigned short *encodedUpdatedRow = rowBuffers + 3 * cols, *columnSums = rowBuffers + 4 * cols;
+	encodeRow(currentGrid[firstRow - 1], encodedAbove);
+	encodeRow(currentGrid[firstRow], encodedRow);
+
+	//With streaming stores, each row is put together here first (see below)
+	std::vector<int> streamedRow(streamingStores ? (cols + 3) / 4 * 4 : 0);
+
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		encodeRow(currentGrid[row + 1], encodedBelow);
+		for (int col = 0; col < cols; ++col)
+			columnSums[col] = encodedAbove[col] + encodedRow[col] + encodedBelow[col];
+
+		//The ghost columns aren't calculated, so they stay as they were
+		encodedUpdatedRow[0] = encodedRow[0];
+		encodedUpdatedRow[cols - 1] = encodedRow[cols - 1];
+
+		int *resultRow = streamingStores ? streamedRow.data() : nextCalculatedGrid[row];
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			//Get the neighbours' counts; the cell on the left is swapped for its updated value
+			unsigned int neighbours = columnSums[col - 1] + columnSums[col] + columnSums[col + 1]
+				- encodedRow[col] - encodedRow[col - 1] + encodedUpdatedRow[col - 1];
+			nFishNeighbours = neighbours & 0xF;
+			nBreedingFish = (neighbours >> 4) & 0xF;
+			nSharkNeighbours = (neighbours >> 8) & 0xF;
+			nBreedingSharks = neighbours >> 12;
+
+			int nextValue;
+			if (currentGrid[row][col] == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					nextValue = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					nextValue = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					nextValue = 0;
+			}
+			else if (currentGrid[row][col] > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					nextValue = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					nextValue = 0;
+				else if (currentGrid[row][col] == 10)	//max age reached; fish dies
+					nextValue = 0;
+				else	//nothing happens to the fish 
+					nextValue = ++currentGrid[row][col];	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					nextValue = 0;
+				else if (sharkDeathOdds > 0 && Utils::getRandomNumber(1, sharkDeathOdds) == 1)	//random causes; shark dies. bad luck.
+					nextValue = 0;
+				else if (currentGrid[row][col] == -20)	//reached max age; shark dies
+					nextValue = 0;
+				else	//nothing happens, shark survives; increment age
+					nextValue = --currentGrid[row][col];
+			}
+
+			resultRow[col] = nextValue;
+			encodedUpdatedRow[col] = encodeCell(currentGrid[row][col]);
+		}
+
+		if (outputs != nullptr)
+			collectRow(resultRow, row, *outputs, *counts);
+
+#ifdef GRID_STREAMING_STORES
+		//Stream the row out a whole cache line at a time; the arena aligns the rows and pads them to whole cache lines
+		if (streamingStores)
+		{
+			for (int col = 0; col < cols; col += 4)
+			{
+				__m128i cells = _mm_loadu_si128(reinterpret_cast<const __m128i*>(resultRow + col));
+				_mm_stream_si128(reinterpret_cast<__m128i*>(nextCalculatedGrid[row] + col), cells);
+			}
+		}
+#endif
+
+		//Move down a row; the buffers that are no longer needed hold the next row below and the next updated row
+		std::swap(encodedAbove, encodedUpdatedRow);
+		std::swap(encodedUpdatedRow, encodedRow);
+		std::swap(encodedRow, encodedBelow);
+	}
+
+#ifdef GRID_STREAMING_STORES
+	//Streaming stores aren't ordered with other stores; make sure they are all done before anyone reads the results
+	if (streamingStores)
+		_mm_sfence();
+#endif
+}
+
+//Encodes a cell as the neighbour categories it counts towards, one per 4 bits:
+//bits 0-3 = fish, bits 4-7 = fish of breeding age, bits 8-11 = shark, bits 12-15 = shark of breeding age
+//A cell has 8 neighbours, so adding up the encoded values of its neighbourhood (up to 9 cells) never carries from one
+//category into the next, and every count can be read straight out of the sum.
+unsigned short Grid::encodeCell(int value)
+{
+	return static_cast<unsigned short>((value > 0) | (value >= 2) << 4 | (value < 0) << 8 | (value <= -3) << 12);
+}
+
+//Encodes a whole row of cells, including the ghost cells
+void Grid::encodeRow(const int *row, unsigned short *outEncodedRow)
+{
+	for (int col = 0; col < cols; ++col)
+		outEncodedRow[col] = encodeCell(row[col]);
 }
\ No newline at end of file
@@ -1,5 +1,45 @@
 #pragma once
+#include"GridArena.h"
+#include<chrono>
 #include<string>
+#include<vector>
+
+class ClusterAnalysis;
+class HistoryWriter;
+class InitialState;
+class SteadyStateDetector;
+class TelemetryServer;
+
+//The oldest a fish and a shark can get
+constexpr int maxFishAge = 10;
+constexpr int maxSharkAge = 20;
+
+//The statistics goToNextGeneration collects about a generation
+struct GenerationCounts
+{
+	long long sharkCount, fishCount, waterCount;
+	//The number of fish and sharks of each age (index 0 is unused)
+	long long fishAges[maxFishAge + 1], sharkAges[maxSharkAge + 1];
+	//The sum of the hashes of the fish and sharks (see SteadyStateDetector::hashRow), if collectLayoutHash was set
+	unsigned long long layoutHash;
+};
+
+//What goToNextGeneration collects about the new generation while calculating it
+struct GenerationOutputs
+{
+	//Which outputs to collect; the counts and image are left alone unless asked for
+	bool collectCounts, collectImage;
+	//Set by prepareOutputs when a steady state detector is watching: the counts then come with the layout hash it
+	//needs, so it doesn't have to go over the grid again
+	bool collectLayoutHash;
+	//Each pixel of the image shows the cell at the top-left of an imageScale x imageScale square of cells
+	int imageScale;
+
+	GenerationCounts counts;
+	//The image's pixels, row by row, as 3 bytes each (blue, green, red) in the colours showGridAsImage uses
+	int imageWidth, imageHeight;
+	std::vector<unsigned char> image;
+};
 
 /*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
 These are represented by integers:
@@ -7,26 +47,86 @@ These are represented by integers:
 < 0 = shark
 ==0 = water
 For sharks and fish, the absolute value of the integer corresponds to their age.
-eg- A cell with value -5 contains a 5-year-old shark.*/
+eg- A cell with value -5 contains a 5-year-old shark.
+
+If lowMemory is set, only one grid is kept in memory instead of two (see calculateRowsInPlace).*/
 class Grid
 {
+	//Times the grid's ghost cell update, kernel and flip on their own
+	friend class KernelBench;
+	//Runs the grid next to a preview of it, comparing them
+	friend class GridPreview;
+
 public:
-	Grid(int rows, int cols);
+	Grid(int rows, int cols, bool lowMemory = false);
 	~Grid();
 	void printToConsole(char shark = 'X', char fish = 'F', char water = ' ');
 	void printStatsToConsole();
+	static void printStatsToConsole(const GenerationOutputs &outputs);
 	float runTest(int nIterations);
-	void calculateNextGridState();
+	void calculateNextGridState(GenerationOutputs *outputs = nullptr);
 	void goToNextGridState();
+	void goToNextGeneration(GenerationOutputs &outputs);
 	void showGridAsImage(std::string additionalInfo = "");
+	static void showGridAsImage(const GenerationOutputs &outputs, std::string additionalInfo = "");
+	void recordHistory(HistoryWriter *writer);
+	void analyseClusters(ClusterAnalysis *analysis, int interval);
+	void publishTelemetry(TelemetryServer *server, int interval);
+	void detectSteadyState(SteadyStateDetector *detector);
+	void setRandomSharkDeaths(bool randomSharkDeaths);
+	bool saveSnapshot(std::string filePath);
+	bool loadSnapshot(std::string filePath);
+	bool loadInitialState(InitialState &state);
+	void restart(int rows, int cols, int sharkPercent, int fishPercent, bool lowMemory = false);
+	void setStreamingStores(bool streamingStores);
+	GridArena::PageKind getPageKind();
+	int getGeneration();
+	static unsigned short encodeCell(int value);
 
 protected:
 	int **currentGrid, **nextCalculatedGrid;
 	int rows, cols;
+	//Holds the memory of both grids
+	GridArena *arena;
+	//Whether the nextCalculatedGrid is written with non-temporal stores
+	bool streamingStores;
+	//In low memory mode there is no nextCalculatedGrid; each generation is calculated in place in the currentGrid,
+	//keeping only a couple of rows of old values on the side
+	bool lowMemory;
+	//Every generation is recorded to this, if it's set
+	HistoryWriter *historyWriter;
+	//If set, the clusters are analysed every clusterAnalysisInterval generations
+	ClusterAnalysis *clusterAnalysis;
+	int clusterAnalysisInterval;
+	//Number of generations since the grid was created
+	int generation;
+	//If set, every telemetryInterval-th generation is published to this, along with how long it took
+	TelemetryServer *telemetryServer;
+	int telemetryInterval;
+	std::chrono::steady_clock::time_point lastGenerationEnd;
+	//If set, every generation is looked at by this, and runTest stops or skips ahead when it says so
+	SteadyStateDetector *steadyStateDetector;
+	//Whether sharks die of random causes; without that, every generation follows from the one before
+	bool randomSharkDeaths;
+	//What calculateNextGridState collects for the steady state detector when there are no other outputs, and the counts
+	//it collected the layout hash of the new generation in, until processGeneration hands them over (or nullptr)
+	GenerationOutputs steadyStateOutputs;
+	GenerationCounts *layoutCounts;
 
 	void allocateMemoryToGridVariables();
+	void processGeneration(std::chrono::steady_clock::time_point copyStart);
 	void initGrid();
 	void initGrid(int sharkPercent, int fishPercent);
 	void updateGhostCells();
 	void getNeighbourCount(int row, int col, int &outSharkCount, int &outFishCount);
+	void getNeighbourCount(int **grid, int row, int col, int &outSharkCount, int &outFishCount);
+	void calculateRows(int firstRow, int lastRow, unsigned short *rowBuffers, int sharkDeathOdds,
+		GenerationOutputs *outputs = nullptr, GenerationCounts *counts = nullptr);
+	void encodeRow(const int *row, unsigned short *outEncodedRow);
+	void calculateRowsInPlace(int firstRow, int lastRow, int *rowAbove, int *rowBelow, int *rowBuffers, int sharkDeathOdds,
+		GenerationOutputs *outputs = nullptr, GenerationCounts *counts = nullptr);
+	void prepareOutputs(GenerationOutputs &outputs);
+	GenerationOutputs *prepareLayoutHash(GenerationOutputs *outputs);
+	void collectRow(const int *cells, int row, GenerationOutputs &outputs, GenerationCounts &counts);
+	static void addCounts(GenerationCounts &total, const GenerationCounts &counts);
 };
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include"stdafx.h"
+#include"GridArena.h"
+
+#include<cstdlib>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include<windows.h>
+#else
+#include<sys/mman.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define CACHE_LINE_SIZE 64
+
+//Allocates nGrids grids of rows x cols cells; rows and cols include the ghost cells
+GridArena::GridArena(int nGrids, int rows, int cols)
+{
+	nBytes = static_cast<size_t>(nGrids) * rows * getRowStride(cols) * sizeof(int);
+	allocateMemory();
+
+	rowPointers = nullptr;
+	layOutRows(nGrids, rows, cols);
+}
+
+GridArena::~GridArena()
+{
+	releaseMemory();
+	delete[] rowPointers;
+}
+
+//Returns the row pointers of the given grid, to be used like the grids allocated a row at a time
+int **GridArena::getGrid(int grid)
+{
+	return rowPointers + static_cast<size_t>(grid) * rows;
+}
+
+//Lays nGrids grids of rows x cols cells out in the arena's memory again, so it can be reused for grids of another size
+//Returns false, leaving the arena as it was, if they don't fit in it
+bool GridArena::reshape(int nGrids, int rows, int cols)
+{
+	if (static_cast<size_t>(nGrids) * rows * getRowStride(cols) * sizeof(int) > nBytes)
+		return false;
+
+	layOutRows(nGrids, rows, cols);
+	return true;
+}
+
+//Returns what kind of pages the arena ended up with
+GridArena::PageKind GridArena::getPageKind()
+{
+	return pageKind;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Allocates nBytes, with the best kind of pages available (see above)
+//Arenas smaller than a huge page always get normal pages, so small grids don't waste most of one.
+void GridArena::allocateMemory()
+{
+	mappedBytes = 0;
+	pageKind = PageKind::NormalPages;
+
+	if (nBytes >= HUGE_PAGE_SIZE)
+	{
+#ifdef _WIN32
+		//Large pages also need the "Lock pages in memory" privilege, which has to be granted and enabled first
+		SIZE_T largePageSize = GetLargePageMinimum();
+		if (largePageSize > 0)
+		{
+			SIZE_T size = (nBytes + largePageSize - 1) / largePageSize * largePageSize;
+			memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (memory != nullptr)
+			{
+				mappedBytes = size;
+				pageKind = PageKind::HugePages;
+				return;
+			}
+		}
+#else
+		size_t size = (nBytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED)
+		{
+			mappedBytes = size;
+			pageKind = PageKind::HugePages;
+			return;
+		}
+#endif
+		//Transparent huge pages can only back whole, aligned 2 MB stretches, so map an extra one and trim the mapping
+		//down to the aligned part
+		memory = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory != MAP_FAILED)
+		{
+			char *start = static_cast<char*>(memory);
+			char *alignedStart = start + (HUGE_PAGE_SIZE - reinterpret_cast<size_t>(start) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+			if (alignedStart > start)
+				munmap(start, alignedStart - start);
+			munmap(alignedStart + size, start + HUGE_PAGE_SIZE - alignedStart);
+			memory = alignedStart;
+			mappedBytes = size;
+#ifdef MADV_HUGEPAGE
+			if (madvise(memory, size, MADV_HUGEPAGE) == 0)
+				pageKind = PageKind::TransparentHugePages;
+#endif
+			return;
+		}
+#endif
+	}
+
+#ifdef _WIN32
+	memory = _aligned_malloc(nBytes, CACHE_LINE_SIZE);
+#else
+	if (posix_memalign(&memory, CACHE_LINE_SIZE, nBytes) != 0)
+		memory = nullptr;
+#endif
+}
+
+//Points the row pointers at the rows of nGrids grids of rows x cols cells, one after the other from the start of the
+//memory
+void GridArena::layOutRows(int nGrids, int rows, int cols)
+{
+	this->rows = rows;
+	size_t rowStride = getRowStride(cols);
+
+	delete[] rowPointers;
+	rowPointers = new int*[static_cast<size_t>(nGrids) * rows];
+	int *row = static_cast<int*>(memory);
+	for (size_t i = 0; i < static_cast<size_t>(nGrids) * rows; ++i, row += rowStride)
+		rowPointers[i] = row;
+}
+
+//Returns how many ints apart the rows are: every row is padded to a whole number of cache lines
+size_t GridArena::getRowStride(int cols)
+{
+	const size_t intsPerLine = CACHE_LINE_SIZE / sizeof(int);
+	return (cols + intsPerLine - 1) / intsPerLine * intsPerLine;
+}
+
+//Frees the memory the way it was allocated
+void GridArena::releaseMemory()
+{
+#ifdef _WIN32
+	if (mappedBytes > 0)
+		VirtualFree(memory, 0, MEM_RELEASE);
+	else
+		_aligned_free(memory);
+#else
+	if (mappedBytes > 0)
+		munmap(memory, mappedBytes);
+	else
+		free(memory);
+#endif
+}
\ No newline at end of file
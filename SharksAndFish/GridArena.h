@@ -0,0 +1,37 @@
+#pragma once
+#include<cstddef>
+
+/*One block of memory holding every row of one or more grids (including their ghost cells), instead of a separate
+allocation per row. Each row starts on a cache line of its own.
+
+Big arenas are backed by 2 MB huge pages where the system has them, which cuts the number of pages a sweep over the
+grid touches by a factor of 512, and with it the TLB misses: first with explicit huge pages (hugetlbfs on Linux,
+large pages on Windows, both of which have to be set up by an administrator), then on Linux by asking for
+transparent huge pages, and if neither works, with normal pages.*/
+class GridArena
+{
+public:
+	enum class PageKind { HugePages, TransparentHugePages, NormalPages };
+
+	GridArena(int nGrids, int rows, int cols);
+	~GridArena();
+	int **getGrid(int grid);
+	bool reshape(int nGrids, int rows, int cols);
+	PageKind getPageKind();
+
+protected:
+	void *memory;
+	//How much of the memory can be used, which stays the same when the arena is reshaped
+	size_t nBytes;
+	//How much was mapped straight from the system (mmap / VirtualAlloc), or 0 if the memory came from the heap
+	size_t mappedBytes;
+	PageKind pageKind;
+	//The row pointers of every grid, one after the other
+	int **rowPointers;
+	int rows;
+
+	void allocateMemory();
+	void releaseMemory();
+	void layOutRows(int nGrids, int rows, int cols);
+	static size_t getRowStride(int cols);
+};
\ No newline at end of file
@@ -2,66 +2,119 @@
 #include"GridHybrid.h"
 #include"Utils.h"
 
+#include<algorithm>
+#include<cstring>
 #include<iostream>
 #include<ctime>
 #include<mpi.h>
+#include<vector>
 #include<opencv2\opencv.hpp>
 
 //NOTE: The terms 'machine(s)' and 'process(ess)' have been used interchaneably throughout the comments of this file.
 
+//The settings used until setTuning or autotune says otherwise
 #define N_THREADS 2
+//Number of rows a thread takes at a time
+#define ROW_BLOCK 1
+
+GridHybrid::GridHybrid(int rows, int cols) : GridMPI(rows, cols)
+{
+	tuning = { N_THREADS, RowSchedule::Guided, ROW_BLOCK };
+}
+
+//Sets the number of threads each process uses, the schedule and the number of rows handed out at a time
+//Every process must be given the same settings
+void GridHybrid::setTuning(const TuningConfig &config)
+{
+	tuning = config;
+	tuning.nThreads = std::max(tuning.nThreads, 1);
+	tuning.rowBlock = std::max(tuning.rowBlock, 1);
+}
+
+//Picks the fastest settings for this grid, the same way GridOMP::autotune does; must be called by every process
+//Process 0 looks the grid up in the profile and tells the others what it found. Otherwise every setting is timed
+//across all the processes, as the time the slowest one took, so they all see the same times and pick the same settings.
+void GridHybrid::autotune(Autotuner &autotuner)
+{
+	std::string key = Autotuner::makeProfileKey("Hybrid, " + std::to_string(nMachines) + " processes", totalRows, cols - 2);
+	TuningConfig config;
+	int foundProfile = rank == 0 && autotuner.findProfile(key, config);
+	MPI_Bcast(&foundProfile, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (foundProfile)
+	{
+		int settings[3] = { config.nThreads, static_cast<int>(config.schedule), config.rowBlock };
+		MPI_Bcast(settings, 3, MPI_INT, 0, MPI_COMM_WORLD);
+		setTuning({ settings[0], static_cast<RowSchedule>(settings[1]), settings[2] });
+		if (rank == 0)
+			std::cout << "Tuned from profile: " << Autotuner::describe(tuning) << std::endl;
+		return;
+	}
+
+	//calculateNextGridState ages the cells of the currentGrid in place, and leaves the cells of the nextCalculatedGrid
+	//that stay empty as they were, so both have to be saved and restored
+	size_t gridSize = static_cast<size_t>(rows) * cols;
+	std::vector<int> savedGrids(2 * gridSize);
+	for (int row = 0; row < rows; ++row)
+	{
+		memcpy(savedGrids.data() + static_cast<size_t>(row) * cols, currentGrid[row], cols * sizeof(int));
+		memcpy(savedGrids.data() + gridSize + static_cast<size_t>(row) * cols, nextCalculatedGrid[row], cols * sizeof(int));
+	}
+
+	auto benchmark = [&](const TuningConfig &candidate)
+	{
+		setTuning(candidate);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double startTime = MPI_Wtime();
+		calculateNextGridState();
+		double time = MPI_Wtime() - startTime, slowestTime;
+		MPI_Allreduce(&time, &slowestTime, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+		//The neighbours may still be reading this process' rows for their ghost rows
+		MPI_Barrier(MPI_COMM_WORLD);
+		for (int row = 0; row < rows; ++row)
+		{
+			memcpy(currentGrid[row], savedGrids.data() + static_cast<size_t>(row) * cols, cols * sizeof(int));
+			memcpy(nextCalculatedGrid[row], savedGrids.data() + gridSize + static_cast<size_t>(row) * cols, cols * sizeof(int));
+		}
+		return slowestTime;
+	};
+	config = autotuner.search(tuning, { 1, 4, 16 }, benchmark);
+
+	setTuning(config);
+	if (rank == 0)
+	{
+		autotuner.saveProfile(key, tuning);
+		std::cout << "Autotuned: " << Autotuner::describe(tuning) << std::endl;
+	}
+}
 
 //Evaluates the rules of the celluar automata and puts values in the nextCalculatedGrid based on them
 void GridHybrid::calculateNextGridState()
 {
 	updateGhostCells();
 
-	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
-
-#pragma omp parallel num_threads(N_THREADS) private(nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish)
-#pragma omp for schedule(guided)
-	//In the for loops, the first and last row and column are excluded because they are ghost cells
-	for (int row = 1; row < rows - 1; ++row)
+	int rowBlock = tuning.rowBlock;
+#pragma omp parallel num_threads(tuning.nThreads)
 	{
-		for (int col = 1; col < cols - 1; ++col)
+		//The schedule has to be written into the pragma, so there's a loop for each
+		//In the for loops, the first and last row are excluded because they are ghost cells
+		if (tuning.schedule == RowSchedule::Static)
+		{
+#pragma omp for schedule(static, rowBlock)
+			for (int row = 1; row < rows - 1; ++row)
+				calculateRow(row);
+		}
+		else if (tuning.schedule == RowSchedule::Dynamic)
 		{
-			//Get the neighbours' counts
-			getNeighbourCount(row, col, nSharkNeighbours, nFishNeighbours);
-			nBreedingFish = nFishNeighbours % 10;
-			nBreedingSharks = nSharkNeighbours % 10;
-			nFishNeighbours /= 10;
-			nSharkNeighbours /= 10;
-
-			if (currentGrid[row][col] == 0)	//cell is empty
-			{
-				//Breeding Rule
-				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
-					nextCalculatedGrid[row][col] = 1;	//spawn fish
-				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
-					nextCalculatedGrid[row][col] = -1;	//spawn shark
-			}
-			else if (currentGrid[row][col] > 0)	//cell has a fish
-			{
-				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
-					nextCalculatedGrid[row][col] = 0;
-				else if (nFishNeighbours == 8)	//overpopulation; fish dies
-					nextCalculatedGrid[row][col] = 0;
-				else if (currentGrid[row][col] == 10)	//max age reached; fish dies
-					nextCalculatedGrid[row][col] = 0;
-				else	//nothing happens to the fish 
-					nextCalculatedGrid[row][col] = ++currentGrid[row][col];	//increment fish's age
-			}
-			else	//cell has a shark
-			{
-				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
-					nextCalculatedGrid[row][col] = 0;
-				else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
-					nextCalculatedGrid[row][col] = 0;
-				else if (currentGrid[row][col] == -20)	//reached max age; shark dies
-					nextCalculatedGrid[row][col] = 0;
-				else	//nothing happens, shark survives; increment age
-					nextCalculatedGrid[row][col] = --currentGrid[row][col];
-			}
+#pragma omp for schedule(dynamic, rowBlock)
+			for (int row = 1; row < rows - 1; ++row)
+				calculateRow(row);
+		}
+		else
+		{
+#pragma omp for schedule(guided, rowBlock)
+			for (int row = 1; row < rows - 1; ++row)
+				calculateRow(row);
 		}
 	}
 }
@@ -79,4 +132,54 @@ float GridHybrid::runTest(int nIterations)
 	}
 	stitchGrid();
 	return clock() - startTime;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Applies the rules to one row of the currentGrid, putting the results in the nextCalculatedGrid
+void GridHybrid::calculateRow(int row)
+{
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+
+	//The first and last column are excluded because they are ghost cells
+	for (int col = 1; col < cols - 1; ++col)
+	{
+		//Get the neighbours' counts
+		getNeighbourCount(row, col, nSharkNeighbours, nFishNeighbours);
+		nBreedingFish = nFishNeighbours % 10;
+		nBreedingSharks = nSharkNeighbours % 10;
+		nFishNeighbours /= 10;
+		nSharkNeighbours /= 10;
+
+		if (currentGrid[row][col] == 0)	//cell is empty
+		{
+			//Breeding Rule
+			if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+				nextCalculatedGrid[row][col] = 1;	//spawn fish
+			else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+				nextCalculatedGrid[row][col] = -1;	//spawn shark
+		}
+		else if (currentGrid[row][col] > 0)	//cell has a fish
+		{
+			if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+				nextCalculatedGrid[row][col] = 0;
+			else if (nFishNeighbours == 8)	//overpopulation; fish dies
+				nextCalculatedGrid[row][col] = 0;
+			else if (currentGrid[row][col] == 10)	//max age reached; fish dies
+				nextCalculatedGrid[row][col] = 0;
+			else	//nothing happens to the fish 
+				nextCalculatedGrid[row][col] = ++currentGrid[row][col];	//increment fish's age
+		}
+		else	//cell has a shark
+		{
+			if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+				nextCalculatedGrid[row][col] = 0;
+			else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
+				nextCalculatedGrid[row][col] = 0;
+			else if (currentGrid[row][col] == -20)	//reached max age; shark dies
+				nextCalculatedGrid[row][col] = 0;
+			else	//nothing happens, shark survives; increment age
+				nextCalculatedGrid[row][col] = --currentGrid[row][col];
+		}
+	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include<string>
+#include"Autotuner.h"
 #include"GridMPI.h"
 
 /*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
@@ -8,11 +9,21 @@ These are represented by integers:
 < 0 = shark
 ==0 = water
 For sharks and fish, the absolute value of the integer corresponds to their age.
-eg- A cell with value -5 contains a 5-year-old shark.*/
+eg- A cell with value -5 contains a 5-year-old shark.
+
+The number of threads each process uses, the schedule and the number of rows handed out at a time can be set with
+setTuning, or picked by autotune.*/
 class GridHybrid : public GridMPI
 {
 public:
-	GridHybrid(int rows, int cols) : GridMPI(rows, cols) {};
+	GridHybrid(int rows, int cols);
+	void setTuning(const TuningConfig &config);
+	void autotune(Autotuner &autotuner);
 	void calculateNextGridState();
 	float runTest(int nIterations);
+
+protected:
+	TuningConfig tuning;
+
+	void calculateRow(int row);
 };
\ No newline at end of file
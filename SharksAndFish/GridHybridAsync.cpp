@@ -0,0 +1,296 @@
+#include"stdafx.h"
+#include"GridHybridAsync.h"
+#include"Grid.h"
+#include"Utils.h"
+#include"CellPacking.h"
+
+#include<algorithm>
+#include<atomic>
+#include<cstring>
+#include<iostream>
+#include<ctime>
+#include<thread>
+#include<omp.h>
+
+//NOTE: The terms 'machine(s)' and 'process(ess)' have been used interchaneably throughout the comments of this file.
+
+//The settings used until setTuning says otherwise
+#define N_THREADS 2
+//Number of rows a thread takes at a time from the rows that don't need the ghost rows
+#define ROW_CHUNK 4
+
+//Instantiates a grid with the given number of rows and columns, and checks which threading level MPI was started with
+GridHybridAsync::GridHybridAsync(int rows, int cols) : GridMPI(rows, cols)
+{
+	tuning = { N_THREADS, RowSchedule::Dynamic, ROW_CHUNK };
+	edgeRows.resize(2 * this->cols);
+
+	int threadSupport;
+	MPI_Query_thread(&threadSupport);
+	overlapCommunication = threadSupport >= MPI_THREAD_FUNNELED;
+
+	if (!overlapCommunication && rank == 0)
+	{
+		std::cout << "MPI was not initialized with MPI_THREAD_FUNNELED or higher!\n"
+			<< "Ghost rows will be exchanged before the threads start." << std::endl;
+	}
+}
+
+//Sets the number of threads each process uses and the number of rows handed out at a time; the schedule is ignored
+//Every process should be given the same settings
+void GridHybridAsync::setTuning(const TuningConfig &config)
+{
+	tuning = config;
+	tuning.nThreads = std::max(tuning.nThreads, 1);
+	tuning.rowBlock = std::max(tuning.rowBlock, 1);
+}
+
+TuningConfig GridHybridAsync::getTuning()
+{
+	return tuning;
+}
+
+//Evaluates the rules of the celluar automata and puts values in the nextCalculatedGrid based on them
+//Rows 2 to rows - 3 only need cells owned by this process, so they are calculated while the ghost rows are in flight
+void GridHybridAsync::calculateNextGridState()
+{
+	updateGhostColumns();
+	//Ghost rows that don't need messages are in place before the threads start
+	copySharedGhostRows();
+	if (haloExchange == HaloExchange::OneSided)
+		putGhostRows();
+
+	//Index 0 of the requests / ghostRowArrived is the top ghost row, index 1 the bottom one
+	//Requests that are MPI_REQUEST_NULL are for ghost rows that are already here
+	MPI_Request receiveRequests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+	MPI_Request sendRequests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+	if (haloExchange == HaloExchange::TwoSided)
+		startGhostRowExchange(receiveRequests, sendRequests);
+	int nMessages = (receiveRequests[0] != MPI_REQUEST_NULL) + (receiveRequests[1] != MPI_REQUEST_NULL);
+
+	std::atomic<bool> ghostRowArrived[2];
+	ghostRowArrived[0] = receiveRequests[0] == MPI_REQUEST_NULL;
+	ghostRowArrived[1] = receiveRequests[1] == MPI_REQUEST_NULL;
+	if (!overlapCommunication)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			if (!ghostRowArrived[i])
+			{
+				MPI_Wait(&receiveRequests[i], MPI_STATUS_IGNORE);
+				finishGhostRow(i);
+				ghostRowArrived[i] = true;
+			}
+		}
+		MPI_Waitall(2, sendRequests, MPI_STATUSES_IGNORE);
+		nMessages = 0;
+	}
+
+	//Rows that only need this process' cells, handed out tuning.rowBlock at a time
+	int nThreads = tuning.nThreads, rowChunk = tuning.rowBlock;
+	int nInteriorRows = std::max(rows - 4, 0);
+	int nInteriorChunks = (nInteriorRows + rowChunk - 1) / rowChunk;
+	std::atomic<int> nextInteriorChunk(0);
+
+	//The first and last actual rows, each split into nThreads segments so the whole team can help with them
+	int nBoundaryRows = rows - 2 > 1 ? 2 : 1;
+	int segmentWidth = (cols - 2 + nThreads - 1) / nThreads;
+	std::atomic<int> nextBoundarySegment(0);
+
+#pragma omp parallel num_threads(nThreads)
+	{
+		std::vector<unsigned short> rowBuffers(5 * cols);
+
+		//The master thread is the only one allowed to call MPI with MPI_THREAD_FUNNELED
+		//It waits for the ghost rows, flagging each one as soon as it lands, and then joins the others
+		if (omp_get_thread_num() == 0 && nMessages > 0)
+		{
+			for (int i = 0; i < nMessages; ++i)
+			{
+				int index;
+				MPI_Waitany(2, receiveRequests, &index, MPI_STATUS_IGNORE);
+				finishGhostRow(index);
+				ghostRowArrived[index] = true;
+			}
+			MPI_Waitall(2, sendRequests, MPI_STATUSES_IGNORE);
+		}
+
+		//Rows that don't depend on the ghost rows
+		for (int chunk = nextInteriorChunk++; chunk < nInteriorChunks; chunk = nextInteriorChunk++)
+		{
+			int firstRow = 2 + chunk * rowChunk;
+			calculateCells(firstRow, std::min(firstRow + rowChunk, rows - 2), 1, cols - 1, rowBuffers.data());
+		}
+
+		//Rows that do; spin until the ghost rows they need are here
+		for (int segment = nextBoundarySegment++; segment < nBoundaryRows * nThreads; segment = nextBoundarySegment++)
+		{
+			int row = segment < nThreads ? 1 : rows - 2;
+			while ((row == 1 && !ghostRowArrived[0]) || (row == rows - 2 && !ghostRowArrived[1]))
+				std::this_thread::yield();
+
+			int firstCol = 1 + (segment % nThreads) * segmentWidth;
+			if (firstCol < cols - 1)
+				calculateCells(row, row + 1, firstCol, std::min(firstCol + segmentWidth, cols - 1), rowBuffers.data());
+		}
+	}
+}
+
+//Runs the grid according to the rules for nIterations, and returns the time it took to complete
+//There is no barrier between iterations; waiting on the ghost rows already keeps neighbouring processes in step
+float GridHybridAsync::runTest(int nIterations)
+{
+	float startTime = clock();
+	for (int i = 0; i < nIterations; ++i)
+	{
+		calculateNextGridState();
+		goToNextGridState();
+	}
+	stitchGrid();
+	return clock() - startTime;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Posts the non-blocking sends and receives for the ghost rows that come from processes on other nodes; the requests
+//for the others are left as they are
+//The first and last actual rows are sent with their ghost columns already filled in, so the ghost corners arrive with
+//the rows, as in GridMPI::updateGhostCells. They are copied first, so they can be aged in place while being sent.
+void GridHybridAsync::startGhostRowExchange(MPI_Request *outReceiveRequests, MPI_Request *outSendRequests)
+{
+	//The previous and next processes' rank, or MPI_PROC_NULL if they're on the same node
+	int prevRank = prevSharedRow == nullptr ? (rank + nMachines - 1) % nMachines : MPI_PROC_NULL;
+	int nextRank = nextSharedRow == nullptr ? (rank + 1) % nMachines : MPI_PROC_NULL;
+
+	//Decide tags for upper and lower rows, same as in GridMPI::updateGhostCells
+	const int upTag = 0;
+	const int downTag = 1;
+
+	if (packedWireFormat)
+	{
+		//Same as below, but through the packed buffers; finishGhostRow unpacks the ghost rows once they arrive
+		if (prevRank != MPI_PROC_NULL)
+		{
+			CellPacking::packCells(currentGrid[1], cols, packedEdgeRows);
+			MPI_Irecv(packedGhostRows, cols, MPI_SIGNED_CHAR, prevRank, downTag, MPI_COMM_WORLD, &outReceiveRequests[0]);
+			MPI_Isend(packedEdgeRows, cols, MPI_SIGNED_CHAR, prevRank, upTag, MPI_COMM_WORLD, &outSendRequests[0]);
+		}
+		if (nextRank != MPI_PROC_NULL)
+		{
+			CellPacking::packCells(currentGrid[rows - 2], cols, packedEdgeRows + cols);
+			MPI_Irecv(packedGhostRows + cols, cols, MPI_SIGNED_CHAR, nextRank, upTag, MPI_COMM_WORLD, &outReceiveRequests[1]);
+			MPI_Isend(packedEdgeRows + cols, cols, MPI_SIGNED_CHAR, nextRank, downTag, MPI_COMM_WORLD, &outSendRequests[1]);
+		}
+		return;
+	}
+
+	//Post the receives first so the messages don't have to be buffered
+	if (prevRank != MPI_PROC_NULL)
+	{
+		memcpy(edgeRows.data(), currentGrid[1], cols * sizeof(int));
+		MPI_Irecv(currentGrid[0], cols, MPI_INT, prevRank, downTag, MPI_COMM_WORLD, &outReceiveRequests[0]);
+		MPI_Isend(edgeRows.data(), cols, MPI_INT, prevRank, upTag, MPI_COMM_WORLD, &outSendRequests[0]);
+	}
+	if (nextRank != MPI_PROC_NULL)
+	{
+		memcpy(edgeRows.data() + cols, currentGrid[rows - 2], cols * sizeof(int));
+		MPI_Irecv(currentGrid[rows - 1], cols, MPI_INT, nextRank, upTag, MPI_COMM_WORLD, &outReceiveRequests[1]);
+		MPI_Isend(edgeRows.data() + cols, cols, MPI_INT, nextRank, downTag, MPI_COMM_WORLD, &outSendRequests[1]);
+	}
+}
+
+//Called once the receive for a ghost row has completed (0 = top ghost row, 1 = bottom ghost row)
+//With the packed wire format the row arrived in packedGhostRows and still has to be unpacked into the grid
+void GridHybridAsync::finishGhostRow(int index)
+{
+	if (packedWireFormat)
+		CellPacking::unpackCells(packedGhostRows + index * cols, cols, currentGrid[index == 0 ? 0 : rows - 1]);
+}
+
+//Applies the rules to the cells in the given range of rows and columns (the last row and column are not included),
+//putting the results in the nextCalculatedGrid; rowBuffers needs space for 5 rows
+//Same as Grid::calculateRows, over part of the rows: the neighbours are counted from encoded column sums, and the
+//cells that survive are aged in place, so the cells above and to the left of a cell in the range are seen as they are
+//after this generation. As in GridOMP, the cells just outside the range are seen as they were, or as another thread
+//left them.
+void GridHybridAsync::calculateCells(int firstRow, int lastRow, int firstCol, int lastCol, unsigned short *rowBuffers)
+{
+	//The row above as it is now, the current row as it was, the row below, the current row as it is now, and the
+	//column sums
+	unsigned short *encodedAbove = rowBuffers, *encodedRow = rowBuffers + cols, *encodedBelow = rowBuffers + 2 * cols;
+	unsigned short *encodedUpdatedRow = rowBuffers + 3 * cols, *columnSums = rowBuffers + 4 * cols;
+	encodeCells(currentGrid[firstRow - 1], firstCol - 1, lastCol + 1, encodedAbove);
+	encodeCells(currentGrid[firstRow], firstCol - 1, lastCol + 1, encodedRow);
+
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		encodeCells(currentGrid[row + 1], firstCol - 1, lastCol + 1, encodedBelow);
+		for (int col = firstCol - 1; col <= lastCol; ++col)
+			columnSums[col] = encodedAbove[col] + encodedRow[col] + encodedBelow[col];
+
+		//The cells either side of the range aren't calculated here, so they stay as they were
+		encodedUpdatedRow[firstCol - 1] = encodedRow[firstCol - 1];
+		encodedUpdatedRow[lastCol] = encodedRow[lastCol];
+
+		for (int col = firstCol; col < lastCol; ++col)
+		{
+			//Get the neighbours' counts; the cell on the left is swapped for its updated value
+			unsigned int neighbours = columnSums[col - 1] + columnSums[col] + columnSums[col + 1]
+				- encodedRow[col] - encodedRow[col - 1] + encodedUpdatedRow[col - 1];
+			nFishNeighbours = neighbours & 0xF;
+			nBreedingFish = (neighbours >> 4) & 0xF;
+			nSharkNeighbours = (neighbours >> 8) & 0xF;
+			nBreedingSharks = neighbours >> 12;
+
+			int nextValue;
+			if (currentGrid[row][col] == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					nextValue = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					nextValue = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					nextValue = 0;
+			}
+			else if (currentGrid[row][col] > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					nextValue = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					nextValue = 0;
+				else if (currentGrid[row][col] == 10)	//max age reached; fish dies
+					nextValue = 0;
+				else	//nothing happens to the fish
+					nextValue = ++currentGrid[row][col];	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					nextValue = 0;
+				else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
+					nextValue = 0;
+				else if (currentGrid[row][col] == -20)	//reached max age; shark dies
+					nextValue = 0;
+				else	//nothing happens, shark survives; increment age
+					nextValue = --currentGrid[row][col];
+			}
+
+			nextCalculatedGrid[row][col] = nextValue;
+			encodedUpdatedRow[col] = Grid::encodeCell(currentGrid[row][col]);
+		}
+
+		//Move down a row; the buffers that are no longer needed hold the next row below and the next updated row
+		std::swap(encodedAbove, encodedUpdatedRow);
+		std::swap(encodedUpdatedRow, encodedRow);
+		std::swap(encodedRow, encodedBelow);
+	}
+}
+
+//Encodes the cells of a row from firstCol to lastCol (both included) into the same places of outEncodedRow
+void GridHybridAsync::encodeCells(const int *row, int firstCol, int lastCol, unsigned short *outEncodedRow)
+{
+	for (int col = firstCol; col <= lastCol; ++col)
+		outEncodedRow[col] = Grid::encodeCell(row[col]);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include<string>
+#include<vector>
+#include"Autotuner.h"
+#include"GridMPI.h"
+#include<mpi.h>
+
+/*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
+These are represented by integers:
+> 0 = fish
+< 0 = shark
+==0 = water
+For sharks and fish, the absolute value of the integer corresponds to their age.
+eg- A cell with value -5 contains a 5-year-old shark.
+
+Like GridHybrid, but the ghost rows are exchanged with non-blocking calls while the threads work on the rows that
+do not need them. The master thread progresses the exchange and then joins the others; the two boundary rows are
+handed out to whichever threads are free once their ghost rows have arrived.
+Only the messages to processes on other nodes are overlapped. Ghost rows from processes on the same node are still
+copied out of the shared window (see GridMPI) before the threads start, which takes no messages at all, and with
+HaloExchange::OneSided the puts are done then too, as in GridMPI::updateGhostCells.
+The edge rows are copied before they are sent, so the cells can be aged in place while they are in flight, and the
+rules are applied the way Grid::calculateRows applies them.
+MPI must be initialized with MPI_Init_thread and at least MPI_THREAD_FUNNELED for the overlap to be used; with a lower
+threading level the exchange is finished before the threads start.
+The number of threads each process uses and the number of rows handed out at a time can be set with setTuning; the
+rows are always handed out as threads become free, so the schedule is not used.*/
+class GridHybridAsync : public GridMPI
+{
+public:
+	GridHybridAsync(int rows, int cols);
+	void setTuning(const TuningConfig &config);
+	TuningConfig getTuning();
+	void calculateNextGridState();
+	float runTest(int nIterations);
+
+protected:
+	TuningConfig tuning;
+	bool overlapCommunication;
+	//This process' first and last actual rows, as they were when the exchange started, while they're being sent
+	std::vector<int> edgeRows;
+
+	void startGhostRowExchange(MPI_Request *outReceiveRequests, MPI_Request *outSendRequests);
+	void finishGhostRow(int index);
+	void calculateCells(int firstRow, int lastRow, int firstCol, int lastCol, unsigned short *rowBuffers);
+	void encodeCells(const int *row, int firstCol, int lastCol, unsigned short *outEncodedRow);
+};
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include"stdafx.h"
 #include"GridMPI.h"
 #include"Utils.h"
+#include"CellPacking.h"
+#include"ClusterAnalysis.h"
+#include"Snapshot.h"
+#include"InitialState.h"
+#include"LiveView.h"
 
+#include<cstring>
 #include<iostream>
 #include<ctime>
 #include<mpi.h>
@@ -10,12 +16,22 @@
 //NOTE: The terms 'machine(s)' and 'process(ess)' have been used interchaneably throughout the comments of this file.
 
 
-//The number of machines / processes that the program is to be run on. This need to be the same as the number in the .bat file.
-constexpr int nMachines = 2;
-
 //Instantiates a grid with the given number of rows and columns
 GridMPI::GridMPI(int rows, int cols)
 {
+	nodeComm = MPI_COMM_NULL;
+	sharedWindow = MPI_WIN_NULL;
+	prevSharedRow = nextSharedRow = nullptr;
+	haloExchange = HaloExchange::TwoSided;
+	ghostRowWindow = MPI_WIN_NULL;
+	ghostRowGroup = MPI_GROUP_NULL;
+	packedEdgeRows = packedGhostRows = nullptr;
+	clusterAnalysis = nullptr;
+	clusterAnalysisInterval = 0;
+	liveView = nullptr;
+	liveViewInterval = 0;
+	generation = 0;
+
 	//To prevent the code from breaking ;-)
 	if (nMachines > rows)
 	{
@@ -68,6 +84,13 @@ GridMPI::GridMPI(int rows, int cols)
 		for (int machine = 1; machine < nMachines; ++machine)
 		{
 			int maxRow = row + rowsPerMachine[machine];
+			if (packedWireFormat)
+			{
+				//All of the machine's rows in a single message
+				sendPackedRows(currentGrid, row, rowsPerMachine[machine], machine, 1);
+				row = maxRow;
+				continue;
+			}
 			int id = 1;
 			for (row = row; row < maxRow; ++row)
 			{
@@ -96,18 +119,32 @@ GridMPI::GridMPI(int rows, int cols)
 		MPI_Status status;
 
 		//Recieve the rows:
-		for (int row = 1; row < this->rows - 1; ++row)
+		if (packedWireFormat)
+			receivePackedRows(currentGrid, 1, this->rows - 2, 0, 1);
+		else
 		{
-			MPI_Recv(currentGrid[row], this->cols, MPI_INT, 0, row, MPI_COMM_WORLD, &status);
+			for (int row = 1; row < this->rows - 1; ++row)
+			{
+				MPI_Recv(currentGrid[row], this->cols, MPI_INT, 0, row, MPI_COMM_WORLD, &status);
+			}
 		}
 	}
 
+	packedEdgeRows = new signed char[2 * this->cols];
+	packedGhostRows = new signed char[2 * this->cols];
+
+	//Move this process' rows into memory that the other processes on the node can see
+	allocateSharedBand();
+
 	//Wait for all processes to reach this point
 	MPI_Barrier(MPI_COMM_WORLD);
 }
 
 GridMPI::~GridMPI()
 {
+	releaseGhostRowWindow();
+	releaseSharedBand();
+
 	for (int i = 0; i < rows; ++i)
 	{
 		delete[] currentGrid[i];
@@ -117,6 +154,83 @@ GridMPI::~GridMPI()
 	delete[] nextCalculatedGrid;
 
 	delete[] rowsPerMachine;
+	delete[] packedEdgeRows;
+	delete[] packedGhostRows;
+}
+
+//Chooses how ghost rows are exchanged with processes on other nodes (see HaloExchange)
+//Neighbours on the same node always read each other's rows from the shared window, whichever method is chosen
+//This has to be called by all the processes together, with the same method
+void GridMPI::setHaloExchange(HaloExchange method)
+{
+	if (method == haloExchange)
+		return;
+
+	if (method == HaloExchange::OneSided)
+		allocateGhostRowWindow();
+	else
+		releaseGhostRowWindow();
+}
+
+//Starts analysing the clusters of fish and sharks every interval generations with the given analysis, until it's
+//called again with nullptr; process 0 prints a summary of the whole grid each time
+//This has to be called by all the processes together, since the analysis needs all of them
+void GridMPI::analyseClusters(ClusterAnalysis *analysis, int interval)
+{
+	clusterAnalysis = analysis;
+	clusterAnalysisInterval = interval > 0 ? interval : 1;
+}
+
+//Starts gathering the grid into the given live view every interval generations, sending only the tiles that changed
+//since the last time (see LiveView), until it's called again with nullptr; the first gather sends the whole grid
+//This has to be called by all the processes together, with views that have the same viewer
+void GridMPI::viewLive(LiveView *view, int interval)
+{
+	liveView = view;
+	liveViewInterval = interval > 0 ? interval : 1;
+}
+
+//Writes the whole grid to one compressed snapshot file (see SnapshotWriter), with each process compressing and writing
+//its own rows; returns false if it couldn't be written
+//This has to be called by all the processes together
+bool GridMPI::saveSnapshot(std::string filePath)
+{
+	int firstRow, nRows;
+	getOwnRows(firstRow, nRows);
+	SnapshotWriter writer;
+	return writer.writeDistributed(filePath, currentGrid, nRows + 2, cols, firstRow, totalRows, MPI_COMM_WORLD);
+}
+
+//Replaces the whole grid with the one in a snapshot file, which has to be the same size; each process reads and
+//decompresses just the bands holding its own rows
+//This has to be called by all the processes together; returns false on all of them if any couldn't load its rows
+bool GridMPI::loadSnapshot(std::string filePath)
+{
+	int firstRow, nRows;
+	getOwnRows(firstRow, nRows);
+	SnapshotReader reader(filePath);
+	int loaded = reader.isValid() && reader.getRows() == totalRows && reader.getCols() == cols - 2
+		&& reader.readRows(firstRow, nRows, currentGrid);
+	if (reader.isValid() && !loaded && rank == 0)
+		std::cout << "Could not load the snapshot in " << filePath << " into the grid!" << std::endl;
+
+	int allLoaded;
+	MPI_Allreduce(&loaded, &allLoaded, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+	return allLoaded != 0;
+}
+
+//Replaces the whole grid with one made from a density map or a pattern (see InitialState); each process fills its own
+//rows, reading only the part of the map they're made from
+//This has to be called by all the processes together; returns false on all of them if any couldn't fill its rows
+bool GridMPI::loadInitialState(InitialState &state)
+{
+	int firstRow, nRows;
+	getOwnRows(firstRow, nRows);
+	int filled = state.fill(currentGrid, nRows + 2, cols, firstRow, totalRows);
+
+	int allFilled;
+	MPI_Allreduce(&filled, &allFilled, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+	return allFilled != 0;
 }
 
 //Prints the contents of the current grid to the console in the form of characters
@@ -187,6 +301,20 @@ void GridMPI::goToNextGridState()
 			currentGrid[row][col] = nextCalculatedGrid[row][col];
 		}
 	}
+
+	++generation;
+	if (clusterAnalysis != nullptr && generation % clusterAnalysisInterval == 0)
+	{
+		ClusterAnalysis::Summary summary = clusterAnalysis->analyseGridMPI(currentGrid, rows, cols, MPI_COMM_WORLD);
+		if (rank == 0)
+			ClusterAnalysis::printSummary(summary, generation);
+	}
+	if (liveView != nullptr && generation % liveViewInterval == 0)
+	{
+		int firstRow, nRows;
+		getOwnRows(firstRow, nRows);
+		liveView->gather(currentGrid, nRows + 2, cols, firstRow, totalRows, MPI_COMM_WORLD);
+	}
 }
 
 //Evaluates the rules of the celluar automata and puts values in the nextCalculatedGrid based on them
@@ -357,22 +485,60 @@ void GridMPI::updateGhostCells()
 
 	static MPI_Status status;
 
-	//rows - we get the rows first, inclusing the two cells (first and last) from the ghost cols
-	//these will contain junk values, but we will update them later
-	
-	//Send this process' actual upper row to the previous process
-	MPI_Send(currentGrid[1], cols, MPI_INT, prevRank, upTag, MPI_COMM_WORLD);
-	//Recieve the bottom ghost row from the next process
-	MPI_Recv(currentGrid[rows - 1], cols, MPI_INT, nextRank, upTag, MPI_COMM_WORLD, &status);
+	//columns - calculating these only requires the current grid
+	//They are done first so that the rows this process hands to its neighbours already have the right corners
+	updateGhostColumns();
 
-	//Send this process' actual lower row to the next process
-	MPI_Send(currentGrid[rows - 2], cols, MPI_INT, nextRank, downTag, MPI_COMM_WORLD);
-	//Recieve the top ghost row from the previous process
-	MPI_Recv(currentGrid[0], cols, MPI_INT, prevRank, downTag, MPI_COMM_WORLD, &status);
+	//rows from processes on the same node
+	copySharedGhostRows();
 
-	//The receives are blocking receives, so no process will pass past this point without having received the ghost rows
+	//rows from processes on other nodes
+	//They are sent along with their ghost columns, which were filled in above, so the ghost corners arrive as part of
+	//the rows and no separate corner messages are needed
+	if (haloExchange == HaloExchange::OneSided)
+	{
+		putGhostRows();
+	}
+	else
+	{
+		//One MPI_Sendrecv per direction; a neighbour on the same node is replaced by MPI_PROC_NULL, which skips that half
+		int upPartner = prevSharedRow == nullptr ? prevRank : MPI_PROC_NULL;
+		int downPartner = nextSharedRow == nullptr ? nextRank : MPI_PROC_NULL;
 
-	//columns - calculating these only requires the current grid
+		if (packedWireFormat)
+		{
+			//Same as below, but through the packed buffers (upper rows first, lower rows second)
+			if (upPartner != MPI_PROC_NULL)
+				CellPacking::packCells(currentGrid[1], cols, packedEdgeRows);
+			if (downPartner != MPI_PROC_NULL)
+				CellPacking::packCells(currentGrid[rows - 2], cols, packedEdgeRows + cols);
+
+			MPI_Sendrecv(packedEdgeRows, cols, MPI_SIGNED_CHAR, upPartner, upTag,
+				packedGhostRows + cols, cols, MPI_SIGNED_CHAR, downPartner, upTag, MPI_COMM_WORLD, &status);
+			MPI_Sendrecv(packedEdgeRows + cols, cols, MPI_SIGNED_CHAR, downPartner, downTag,
+				packedGhostRows, cols, MPI_SIGNED_CHAR, upPartner, downTag, MPI_COMM_WORLD, &status);
+
+			//Nothing was received from MPI_PROC_NULL, and those ghost rows have already been read from the shared window
+			if (upPartner != MPI_PROC_NULL)
+				CellPacking::unpackCells(packedGhostRows, cols, currentGrid[0]);
+			if (downPartner != MPI_PROC_NULL)
+				CellPacking::unpackCells(packedGhostRows + cols, cols, currentGrid[rows - 1]);
+		}
+		else
+		{
+			//Send this process' actual upper row to the previous process, and receive the bottom ghost row from the next process
+			MPI_Sendrecv(currentGrid[1], cols, MPI_INT, upPartner, upTag,
+				currentGrid[rows - 1], cols, MPI_INT, downPartner, upTag, MPI_COMM_WORLD, &status);
+			//Send this process' actual lower row to the next process, and receive the top ghost row from the previous process
+			MPI_Sendrecv(currentGrid[rows - 2], cols, MPI_INT, downPartner, downTag,
+				currentGrid[0], cols, MPI_INT, upPartner, downTag, MPI_COMM_WORLD, &status);
+		}
+	}
+}
+
+//Fills in the ghost columns of the actual rows, from the other end of each row
+void GridMPI::updateGhostColumns()
+{
 	for (int row = 1; row < rows - 1; ++row)
 	{
 		//left column
@@ -380,52 +546,27 @@ void GridMPI::updateGhostCells()
 		//right column
 		currentGrid[row][cols - 1] = currentGrid[row][1];
 	}
+}
 
-	//corners
-	//The only true "corners" are the top ghost corners for the first process and the bottom ghost corners for the last process
-	//For all other "corners", they are just copies of the actual cell in the opposite column (exactly like we calculated in the column loop above)
-	/*Tags used for sending are:
-	Top left = 3
-	Top right = 4
-	Bottom left = 5
-	Bottom right = 6*/
-	if (rank == 0)
-	{
-		//send the actual top corners to the last process
-		MPI_Send(&currentGrid[1][1], 1, MPI_INT, nMachines - 1, 3, MPI_COMM_WORLD);			//top-left
-		MPI_Send(&currentGrid[1][cols - 2], 1, MPI_INT, nMachines - 1, 4, MPI_COMM_WORLD);	//top-right
+//Copies the ghost rows that belong to processes on the same node straight out of their memory
+//Waits until every process on the node has filled in its ghost columns, copies the neighbours' rows, and waits again
+//so that no process changes its rows (while calculating, or in goToNextGridState) before its neighbours have copied
+//them. Does nothing if the processes' rows aren't in a shared window.
+void GridMPI::copySharedGhostRows()
+{
+	if (sharedWindow == MPI_WIN_NULL)
+		return;
 
-		//Receive the ghost corners from the last process
-		MPI_Recv(&currentGrid[0][0], 1, MPI_INT, nMachines - 1, 6, MPI_COMM_WORLD, &status);		//top-left
-		MPI_Recv(&currentGrid[0][cols - 1], 1, MPI_INT, nMachines - 1, 5, MPI_COMM_WORLD, &status);	//top-right
-	}
-	else if (rank == nMachines - 1)
-	{
-		//send the actual bottom corners to the first process
-		MPI_Send(&currentGrid[rows - 2][1], 1, MPI_INT, 0, 5, MPI_COMM_WORLD);			//bottom-left
-		MPI_Send(&currentGrid[rows - 2][cols - 2], 1, MPI_INT, 0, 6, MPI_COMM_WORLD);	//bottom-right
+	MPI_Win_sync(sharedWindow);
+	MPI_Barrier(nodeComm);
+	MPI_Win_sync(sharedWindow);
 
-		//Receive the ghost corners from the first process
-		MPI_Recv(&currentGrid[rows - 1][0], 1, MPI_INT, 0, 4, MPI_COMM_WORLD, &status);		//bottom-left
-		MPI_Recv(&currentGrid[rows - 1][cols - 1], 1, MPI_INT, 0, 3, MPI_COMM_WORLD, &status);		//bottom-right
-	}
+	if (prevSharedRow != nullptr)
+		memcpy(currentGrid[0], prevSharedRow, cols * sizeof(int));
+	if (nextSharedRow != nullptr)
+		memcpy(currentGrid[rows - 1], nextSharedRow, cols * sizeof(int));
 
-	//Calculate the top ghost corners as copies of the opposite column's cells
-	if (rank != 0)
-	{
-		//top-left
-		currentGrid[0][0] = currentGrid[0][cols - 2];
-		//top-right
-		currentGrid[0][cols - 1] = currentGrid[0][1];
-	}
-	//Calculate the bottom ghost corners as copies of the opposite column's cells
-	if (rank != nMachines - 1)
-	{
-		//bottom-left
-		currentGrid[rows - 1][0] = currentGrid[rows - 1][cols - 2];
-		//Bottom-right
-		currentGrid[rows - 1][cols - 1] = currentGrid[rows - 1][1];
-	}
+	MPI_Barrier(nodeComm);
 }
 
 //Calculates the number of neighbours of each type a cell has, and returns them through the arguments
@@ -482,17 +623,21 @@ void GridMPI::getNeighbourCount(int row, int col, int &outSharkCount, int &outFi
 //Prints the collected grid
 void GridMPI::stitchGrid()
 {
+	//Machine 0's rows are about to be replaced by the complete grid, so they have to be back on the heap
+	releaseGhostRowWindow();
+	releaseSharedBand();
+
 	if (rank == 0)
 	{
 		int **completeGrid = new int*[totalRows + 2];
-		//Copy the process' rows into the grid
-		for (int row = 1; row < rows + 1; ++row)
+		//Copy the process' rows (and the top ghost row) into the grid
+		for (int row = 0; row < rows - 1; ++row)
 		{
 			completeGrid[row] = new int[cols];
 			for (int col = 0; col < cols; ++col)
-				completeGrid[row][col] = currentGrid[row + 1][col];
+				completeGrid[row][col] = currentGrid[row][col];
 		}
-		for (int row = rows + 1; row < totalRows + 2; ++row)
+		for (int row = rows - 1; row < totalRows + 2; ++row)
 		{
 			completeGrid[row] = new int[cols];
 		}
@@ -506,6 +651,13 @@ void GridMPI::stitchGrid()
 		for (int machine = 1; machine < nMachines; ++machine)
 		{
 			int maxRow = row + rowsPerMachine[machine];
+			if (packedWireFormat)
+			{
+				//All of the machine's rows in a single message
+				receivePackedRows(completeGrid, row, rowsPerMachine[machine], machine, 1);
+				row = maxRow;
+				continue;
+			}
 			int id = 1;
 			for (row = row; row < maxRow; ++row)
 			{
@@ -522,8 +674,10 @@ void GridMPI::stitchGrid()
 		}
 		delete[] currentGrid;
 		delete[] nextCalculatedGrid;
-		//Just to be safe
-		nextCalculatedGrid = nullptr;
+		//Give the whole grid a matching nextCalculatedGrid so that it can still be run and deallocated like any other
+		nextCalculatedGrid = new int*[totalRows + 2];
+		for (int row = 0; row < totalRows + 2; ++row)
+			nextCalculatedGrid[row] = new int[cols];
 
 		//make the whole grid the current grid
 		currentGrid = completeGrid;
@@ -535,9 +689,221 @@ void GridMPI::stitchGrid()
 	else
 	{
 		//send all the rows to machine 0
-		for (int row = 1; row < rows - 1; ++row)
+		if (packedWireFormat)
+			sendPackedRows(currentGrid, 1, rows - 2, 0, 1);
+		else
 		{
-			MPI_Send(currentGrid[row], cols, MPI_INT, 0, row, MPI_COMM_WORLD);
+			for (int row = 1; row < rows - 1; ++row)
+			{
+				MPI_Send(currentGrid[row], cols, MPI_INT, 0, row, MPI_COMM_WORLD);
+			}
 		}
 	}
+}
+
+//Moves this process' actual rows into a window shared with the other processes on the same node, and finds out which
+//of the neighbouring processes' rows can be read directly from there
+//The ghost rows and the nextCalculatedGrid stay on the heap, since only the actual rows are ever read by other processes
+void GridMPI::allocateSharedBand()
+{
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+
+	//Let every process' part of the window be placed in memory close to it, rather than in one contiguous block
+	MPI_Info info;
+	MPI_Info_create(&info);
+	MPI_Info_set(info, "alloc_shared_noncontig", "true");
+
+	int *band;
+	MPI_Aint bandSize = static_cast<MPI_Aint>(rows - 2) * cols * sizeof(int);
+	MPI_Win_allocate_shared(bandSize, sizeof(int), info, nodeComm, &band, &sharedWindow);
+	MPI_Info_free(&info);
+
+	//Copy the actual rows into the window and point the grid at them
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		int *sharedRow = band + static_cast<size_t>(row - 1) * cols;
+		memcpy(sharedRow, currentGrid[row], cols * sizeof(int));
+		delete[] currentGrid[row];
+		currentGrid[row] = sharedRow;
+	}
+
+	//Find the neighbours' ranks within the node; MPI_UNDEFINED means they are on another node
+	int neighbours[2] = { (rank + nMachines - 1) % nMachines, (rank + 1) % nMachines };
+	int nodeNeighbours[2];
+	MPI_Group worldGroup, nodeGroup;
+	MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+	MPI_Comm_group(nodeComm, &nodeGroup);
+	MPI_Group_translate_ranks(worldGroup, 2, neighbours, nodeGroup, nodeNeighbours);
+	MPI_Group_free(&worldGroup);
+	MPI_Group_free(&nodeGroup);
+
+	MPI_Aint size;
+	int dispUnit;
+	int *neighbourBand;
+	//The top ghost row is the previous process' last actual row
+	if (nodeNeighbours[0] != MPI_UNDEFINED)
+	{
+		MPI_Win_shared_query(sharedWindow, nodeNeighbours[0], &size, &dispUnit, &neighbourBand);
+		prevSharedRow = neighbourBand + static_cast<size_t>(rowsPerMachine[neighbours[0]] - 1) * cols;
+	}
+	//The bottom ghost row is the next process' first actual row
+	if (nodeNeighbours[1] != MPI_UNDEFINED)
+	{
+		MPI_Win_shared_query(sharedWindow, nodeNeighbours[1], &size, &dispUnit, &neighbourBand);
+		nextSharedRow = neighbourBand;
+	}
+
+	//Keep a passive access epoch open for the whole run; updateGhostCells only needs MPI_Win_sync and barriers then
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, sharedWindow);
+}
+
+//Moves this process' actual rows back onto the heap and frees the shared window
+//This has to be called by all the processes together, unless MPI has already been finalized, in which case the
+//window went away with it and only the row pointers need to be dropped
+void GridMPI::releaseSharedBand()
+{
+	if (sharedWindow == MPI_WIN_NULL)
+		return;
+
+	int isFinalized;
+	MPI_Finalized(&isFinalized);
+
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		int *heapRow = isFinalized ? nullptr : new int[cols];
+		if (heapRow != nullptr)
+			memcpy(heapRow, currentGrid[row], cols * sizeof(int));
+		currentGrid[row] = heapRow;
+	}
+
+	if (!isFinalized)
+	{
+		MPI_Win_unlock_all(sharedWindow);
+		MPI_Win_free(&sharedWindow);
+		MPI_Comm_free(&nodeComm);
+	}
+	sharedWindow = MPI_WIN_NULL;
+	nodeComm = MPI_COMM_NULL;
+	prevSharedRow = nextSharedRow = nullptr;
+}
+
+//Moves the ghost rows into a window that the neighbouring processes can put their edge rows into, and sets up the
+//group of neighbours on other nodes that access it
+void GridMPI::allocateGhostRowWindow()
+{
+	int *ghostRows;
+	MPI_Win_allocate(2 * cols * sizeof(int), sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &ghostRows, &ghostRowWindow);
+
+	memcpy(ghostRows, currentGrid[0], cols * sizeof(int));
+	memcpy(ghostRows + cols, currentGrid[rows - 1], cols * sizeof(int));
+	delete[] currentGrid[0];
+	delete[] currentGrid[rows - 1];
+	currentGrid[0] = ghostRows;
+	currentGrid[rows - 1] = ghostRows + cols;
+
+	//Only neighbours that aren't read through the shared window take part; with 2 processes both are the same one
+	int neighbours[2];
+	int nNeighbours = 0;
+	if (prevSharedRow == nullptr)
+		neighbours[nNeighbours++] = (rank + nMachines - 1) % nMachines;
+	if (nextSharedRow == nullptr && (nNeighbours == 0 || neighbours[0] != (rank + 1) % nMachines))
+		neighbours[nNeighbours++] = (rank + 1) % nMachines;
+
+	if (nNeighbours > 0)
+	{
+		MPI_Group worldGroup;
+		MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+		MPI_Group_incl(worldGroup, nNeighbours, neighbours, &ghostRowGroup);
+		MPI_Group_free(&worldGroup);
+	}
+
+	haloExchange = HaloExchange::OneSided;
+}
+
+//Moves the ghost rows back onto the heap and frees the window; must be called by all the processes together
+//(see releaseSharedBand for what happens once MPI has been finalized)
+void GridMPI::releaseGhostRowWindow()
+{
+	if (ghostRowWindow == MPI_WIN_NULL)
+		return;
+
+	int isFinalized;
+	MPI_Finalized(&isFinalized);
+
+	int *ghostRows = currentGrid[0];
+	currentGrid[0] = isFinalized ? nullptr : new int[cols];
+	currentGrid[rows - 1] = isFinalized ? nullptr : new int[cols];
+
+	if (!isFinalized)
+	{
+		memcpy(currentGrid[0], ghostRows, cols * sizeof(int));
+		memcpy(currentGrid[rows - 1], ghostRows + cols, cols * sizeof(int));
+
+		if (ghostRowGroup != MPI_GROUP_NULL)
+			MPI_Group_free(&ghostRowGroup);
+		MPI_Win_free(&ghostRowWindow);
+	}
+	ghostRowWindow = MPI_WIN_NULL;
+	ghostRowGroup = MPI_GROUP_NULL;
+	haloExchange = HaloExchange::TwoSided;
+}
+
+//Puts this process' edge rows into the ghost rows of the neighbours on other nodes, and waits for theirs to arrive
+//Uses post-start-complete-wait synchronization, so a process only waits on its own neighbours, and a neighbour cannot
+//put the next generation's rows before this process has posted again (i.e. has finished reading the current ones)
+void GridMPI::putGhostRows()
+{
+	if (ghostRowGroup == MPI_GROUP_NULL)
+		return;
+
+	//Expose our ghost rows to the neighbours, and start accessing theirs
+	MPI_Win_post(ghostRowGroup, 0, ghostRowWindow);
+	MPI_Win_start(ghostRowGroup, 0, ghostRowWindow);
+
+	//Our actual upper row is the previous process' bottom ghost row (the second row of its window)
+	if (prevSharedRow == nullptr)
+		MPI_Put(currentGrid[1], cols, MPI_INT, (rank + nMachines - 1) % nMachines, cols, cols, MPI_INT, ghostRowWindow);
+	//Our actual lower row is the next process' top ghost row (the first row of its window)
+	if (nextSharedRow == nullptr)
+		MPI_Put(currentGrid[rows - 2], cols, MPI_INT, (rank + 1) % nMachines, 0, cols, MPI_INT, ghostRowWindow);
+
+	//Finish our puts, then wait for the neighbours' puts into our ghost rows
+	MPI_Win_complete(ghostRowWindow);
+	MPI_Win_wait(ghostRowWindow);
+}
+
+//Packs nRows rows of the grid, starting at firstRow, and sends them to the destination process as one message
+void GridMPI::sendPackedRows(int **grid, int firstRow, int nRows, int destination, int tag)
+{
+	signed char *packedRows = new signed char[static_cast<size_t>(nRows) * cols];
+	for (int i = 0; i < nRows; ++i)
+		CellPacking::packCells(grid[firstRow + i], cols, packedRows + static_cast<size_t>(i) * cols);
+
+	MPI_Send(packedRows, nRows * cols, MPI_SIGNED_CHAR, destination, tag, MPI_COMM_WORLD);
+	delete[] packedRows;
+}
+
+//Receives nRows rows sent with sendPackedRows and unpacks them into the grid, starting at firstRow
+void GridMPI::receivePackedRows(int **grid, int firstRow, int nRows, int source, int tag)
+{
+	signed char *packedRows = new signed char[static_cast<size_t>(nRows) * cols];
+	MPI_Recv(packedRows, nRows * cols, MPI_SIGNED_CHAR, source, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+	for (int i = 0; i < nRows; ++i)
+		CellPacking::unpackCells(packedRows + static_cast<size_t>(i) * cols, cols, grid[firstRow + i]);
+	delete[] packedRows;
+}
+
+//Finds which of the grid's rows this process holds: the first one (counting from 0, without ghost rows) and how many
+//After stitchGrid, process 0 holds the whole grid and the others' rows are out of date, so they hold none
+void GridMPI::getOwnRows(int &outFirstRow, int &outRows)
+{
+	int localRows = rows - 2, allRows;
+	MPI_Allreduce(&localRows, &allRows, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+	bool isStitched = allRows > totalRows;
+
+	outFirstRow = 0;
+	for (int machine = 0; machine < rank && !isStitched; ++machine)
+		outFirstRow += rowsPerMachine[machine];
+	outRows = isStitched && rank != 0 ? 0 : localRows;
 }
\ No newline at end of file
@@ -1,5 +1,18 @@
 #pragma once
 #include<string>
+#include<mpi.h>
+
+class ClusterAnalysis;
+class InitialState;
+class LiveView;
+
+//The number of machines / processes that the program is to be run on. This need to be the same as the number in the .bat file.
+constexpr int nMachines = 2;
+
+//Whether rows sent between processes are packed to one byte per cell (see CellPacking) instead of being sent as ints
+//Applies to the ghost rows (two-sided exchange only), the initial distribution of the grid and stitchGrid. Off unless
+//turned on here, so existing runs keep sending ints.
+constexpr bool packedWireFormat = false;
 
 /*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
 These are represented by integers:
@@ -11,8 +24,18 @@ eg- A cell with value -5 contains a 5-year-old shark.*/
 class GridMPI
 {
 public:
+	//How ghost rows are exchanged with processes on other nodes
+	//TwoSided: MPI_Send / MPI_Recv pairs; OneSided: each process MPI_Puts its edge rows into its neighbours' ghost rows
+	enum class HaloExchange { TwoSided, OneSided };
+
 	GridMPI(int rows, int cols);
 	~GridMPI();
+	void setHaloExchange(HaloExchange method);
+	void analyseClusters(ClusterAnalysis *analysis, int interval);
+	void viewLive(LiveView *view, int interval);
+	bool saveSnapshot(std::string filePath);
+	bool loadSnapshot(std::string filePath);
+	bool loadInitialState(InitialState &state);
 	void printToConsole(char shark = 'X', char fish = 'F', char water = ' ');
 	void printStatsToConsole();
 	float runTest(int nIterations);
@@ -26,10 +49,45 @@ protected:
 	int rank, totalRows;
 	int *rowsPerMachine;
 
+	//Processes on the same node keep their actual rows in a shared window, so they can read each other's rows directly
+	//prevSharedRow / nextSharedRow point to the neighbours' rows that make up this process' ghost rows, and are
+	//nullptr when that neighbour is on another node (in which case the row is sent as a message)
+	MPI_Comm nodeComm;
+	MPI_Win sharedWindow;
+	int *prevSharedRow, *nextSharedRow;
+
+	//For HaloExchange::OneSided, both ghost rows live in ghostRowWindow (top ghost row first), and ghostRowGroup holds
+	//the neighbours on other nodes that put rows into it (MPI_GROUP_NULL if there are none)
+	HaloExchange haloExchange;
+	MPI_Win ghostRowWindow;
+	MPI_Group ghostRowGroup;
+
+	//Buffers for the packed wire format: this process' two edge rows going out, and the two ghost rows coming in
+	signed char *packedEdgeRows, *packedGhostRows;
+
+	//If set, the clusters are analysed every clusterAnalysisInterval generations, across all the processes
+	ClusterAnalysis *clusterAnalysis;
+	int clusterAnalysisInterval;
+	//If set, the changed parts of the grid are gathered into liveView every liveViewInterval generations
+	LiveView *liveView;
+	int liveViewInterval;
+	//Number of generations since the grid was created
+	int generation;
+
 	void allocateMemoryToGridVariables();
 	void initGrid();
 	void initGrid(int sharkPercent, int fishPercent);
 	void updateGhostCells();
+	void updateGhostColumns();
+	void copySharedGhostRows();
 	void getNeighbourCount(int row, int col, int &outSharkCount, int &outFishCount);
 	void stitchGrid();
+	void allocateSharedBand();
+	void releaseSharedBand();
+	void allocateGhostRowWindow();
+	void releaseGhostRowWindow();
+	void putGhostRows();
+	void sendPackedRows(int **grid, int firstRow, int nRows, int destination, int tag);
+	void receivePackedRows(int **grid, int firstRow, int nRows, int source, int tag);
+	void getOwnRows(int &outFirstRow, int &outRows);
 };
\ No newline at end of file
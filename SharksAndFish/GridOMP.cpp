@@ -1,69 +1,155 @@
 #include"stdafx.h"
 #include"GridOMP.h"
 #include"Utils.h"
+#include"SteadyStateDetector.h"
 
+#include<algorithm>
 #include<iostream>
+#include<cstring>
 #include<ctime>
+#include<utility>
+#include<vector>
 #include<opencv2\opencv.hpp>
 #include<omp.h>
 
+//The settings used until setTuning or autotune says otherwise
 #define N_THREADS 12
+//Number of rows a thread takes at a time
+#define ROW_BLOCK 16
 
 
+GridOMP::GridOMP(int rows, int cols, bool lowMemory) : Grid(rows, cols, lowMemory)
+{
+	tuning = { N_THREADS, RowSchedule::Guided, ROW_BLOCK };
+}
+
+//Sets the number of threads, the schedule and the number of rows handed out at a time
+void GridOMP::setTuning(const TuningConfig &config)
+{
+	tuning = config;
+	tuning.nThreads = std::max(tuning.nThreads, 1);
+	tuning.rowBlock = std::max(tuning.rowBlock, 1);
+}
+
+//Returns the number of threads, the schedule and the number of rows handed out at a time
+TuningConfig GridOMP::getTuning()
+{
+	return tuning;
+}
+
+//Picks the fastest settings for this grid on this machine: from the autotuner's profile if this size of grid has been
+//tuned before, or by timing calculateNextGridState with different settings otherwise (see Autotuner)
+//The grid is put back the way it was after every timing, so the simulation carries on from where it was; only the
+//random numbers used up along the way are different.
+void GridOMP::autotune(Autotuner &autotuner)
+{
+	std::string key = Autotuner::makeProfileKey(lowMemory ? "OMP low memory" : "OMP", rows - 2, cols - 2);
+	TuningConfig config;
+	if (autotuner.findProfile(key, config))
+	{
+		setTuning(config);
+		std::cout << "Tuned from profile: " << Autotuner::describe(tuning) << std::endl;
+		return;
+	}
+
+	//calculateNextGridState ages the cells of the currentGrid in place, so it has to be saved and restored
+	std::vector<int> savedGrid(static_cast<size_t>(rows) * cols);
+	for (int row = 0; row < rows; ++row)
+		memcpy(savedGrid.data() + static_cast<size_t>(row) * cols, currentGrid[row], cols * sizeof(int));
+	auto restoreGrid = [&]()
+	{
+		for (int row = 0; row < rows; ++row)
+			memcpy(currentGrid[row], savedGrid.data() + static_cast<size_t>(row) * cols, cols * sizeof(int));
+	};
+
+	auto benchmark = [&](const TuningConfig &candidate)
+	{
+		setTuning(candidate);
+		double startTime = omp_get_wtime();
+		calculateNextGridState();
+		double time = omp_get_wtime() - startTime;
+		restoreGrid();
+		return time;
+	};
+	//The row blocks only matter with two grids; in low memory mode every thread gets one band of rows
+	std::vector<int> rowBlocks;
+	if (!lowMemory)
+		rowBlocks = { 1, 4, 16, 64 };
+	config = autotuner.search(tuning, rowBlocks, benchmark);
+
+	setTuning(config);
+	autotuner.saveProfile(key, tuning);
+	std::cout << "Autotuned: " << Autotuner::describe(tuning) << std::endl;
+}
+
 //Evaluates the rules of the celluar automata and puts values in the nextCalculatedGrid based on them
-void GridOMP::calculateNextGridState()
+//If outputs is given, they are collected for the new generation as well (see Grid::goToNextGeneration)
+void GridOMP::calculateNextGridState(GenerationOutputs *outputs)
 {
 	updateGhostCells();
+	outputs = prepareLayoutHash(outputs);
 
-	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
-	//In the for loops, the first and last row and column are excluded because they are ghost cells
-#pragma omp parallel num_threads(N_THREADS) private(nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish)
-#pragma omp for schedule(guided)
-	for (int row = 1; row < rows - 1; ++row)
+	if (lowMemory)
 	{
-		for (int col = 1; col < cols - 1; ++col)
+		calculateNextGridStateInPlace(outputs);
+		return;
+	}
+
+	//The rows are handed out in blocks of tuning.rowBlock, since calculateRows reuses work from one row to the next
+	int rowBlock = tuning.rowBlock;
+	int nBlocks = (rows - 2 + rowBlock - 1) / rowBlock;
+#pragma omp parallel num_threads(tuning.nThreads)
+	{
+		std::vector<unsigned short> rowBuffers(5 * cols);
+		//Each thread counts its own rows, and adds them to the total at the end
+		GenerationCounts counts = GenerationCounts();
+		auto calculateBlock = [&](int block)
 		{
-			//Get the neighbours' counts
-			getNeighbourCount(row, col, nSharkNeighbours, nFishNeighbours);
-			nBreedingFish = nFishNeighbours % 10;
-			nBreedingSharks = nSharkNeighbours % 10;
-			nFishNeighbours /= 10;
-			nSharkNeighbours /= 10;
-
-			if (currentGrid[row][col] == 0)	//cell is empty
-			{
-				//Breeding Rule
-				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
-					nextCalculatedGrid[row][col] = 1;	//spawn fish
-				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
-					nextCalculatedGrid[row][col] = -1;	//spawn shark
-			}
-			else if (currentGrid[row][col] > 0)	//cell has a fish
-			{
-				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
-					nextCalculatedGrid[row][col] = 0;
-				else if (nFishNeighbours == 8)	//overpopulation; fish dies
-					nextCalculatedGrid[row][col] = 0;
-				else if (currentGrid[row][col] == 10)	//max age reached; fish dies
-					nextCalculatedGrid[row][col] = 0;
-				else	//nothing happens to the fish 
-					nextCalculatedGrid[row][col] = ++currentGrid[row][col];	//increment fish's age
-			}
-			else	//cell has a shark
-			{
-				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
-					nextCalculatedGrid[row][col] = 0;
-				else if (Utils::getRandomNumber(1, 53) == 1)	//random causes; shark dies. bad luck.
-					nextCalculatedGrid[row][col] = 0;
-				else if (currentGrid[row][col] == -20)	//reached max age; shark dies
-					nextCalculatedGrid[row][col] = 0;
-				else	//nothing happens, shark survives; increment age
-					nextCalculatedGrid[row][col] = --currentGrid[row][col];
-			}
+			calculateRows(1 + block * rowBlock, std::min(1 + (block + 1) * rowBlock, rows - 1), rowBuffers.data(),
+				randomSharkDeaths ? 53 : 0, outputs, &counts);
+		};
+
+		//The schedule has to be written into the pragma, so there's a loop for each
+		if (tuning.schedule == RowSchedule::Static)
+		{
+#pragma omp for schedule(static) nowait
+			for (int block = 0; block < nBlocks; ++block)
+				calculateBlock(block);
+		}
+		else if (tuning.schedule == RowSchedule::Dynamic)
+		{
+#pragma omp for schedule(dynamic) nowait
+			for (int block = 0; block < nBlocks; ++block)
+				calculateBlock(block);
+		}
+		else
+		{
+#pragma omp for schedule(guided) nowait
+			for (int block = 0; block < nBlocks; ++block)
+				calculateBlock(block);
+		}
+
+		if (outputs != nullptr && (outputs->collectCounts || outputs->collectLayoutHash))
+		{
+#pragma omp critical
+			addCounts(outputs->counts, counts);
 		}
 	}
 }
 
+//Calculates the next generation and makes it the current one in a single pass; see Grid::goToNextGeneration
+void GridOMP::goToNextGeneration(GenerationOutputs &outputs)
+{
+	prepareOutputs(outputs);
+	calculateNextGridState(&outputs);
+
+	auto copyStart = std::chrono::steady_clock::now();
+	if (!lowMemory)
+		std::swap(currentGrid, nextCalculatedGrid);
+
+	processGeneration(copyStart);
+}
+
 //Runs the grid according to the rules for nIterations, and returns the time it took to complete
 float GridOMP::runTest(int nIterations)
 {
@@ -72,6 +158,9 @@ float GridOMP::runTest(int nIterations)
 	{
 		calculateNextGridState();
 		goToNextGridState();
+		//Stop early, or skip whole cycles, once the detector knows how the run ends
+		if (steadyStateDetector != nullptr)
+			nIterations = i + 1 + steadyStateDetector->skipAhead(nIterations - i - 1);
 	}
 	return clock() - startTime;
 }
@@ -88,7 +177,7 @@ void GridOMP::showGridAsImage(std::string additionalInfo)
 												//Create the image (pixels will be empty)
 	Mat gridImage = Mat(rows - 2, cols - 2, CV_8UC3);
 
-#pragma omp parallel num_threads(N_THREADS)
+#pragma omp parallel num_threads(tuning.nThreads)
 #pragma omp for schedule(guided)
 	//Assign a colour to each pixel depending on what the corresponding cell contains
 	for (int row = 1; row < rows - 1; ++row)
@@ -106,4 +195,37 @@ void GridOMP::showGridAsImage(std::string additionalInfo)
 
 	cv::imshow("Sharks and Fish" + std::string(" ") + additionalInfo, gridImage);
 	cv::waitKey(0);
+}
+
+//Low memory version of calculateNextGridState; see Grid::calculateRowsInPlace
+//Each thread updates one contiguous band of rows in place. The rows just above and below a band belong to other
+//threads, which will be overwriting them, so every thread first saves the old values of those two rows.
+void GridOMP::calculateNextGridStateInPlace(GenerationOutputs *outputs)
+{
+#pragma omp parallel num_threads(tuning.nThreads)
+	{
+		int nThreads = omp_get_num_threads();
+		int thread = omp_get_thread_num();
+		int firstRow = 1 + static_cast<long long>(rows - 2) * thread / nThreads;
+		int lastRow = 1 + static_cast<long long>(rows - 2) * (thread + 1) / nThreads;
+
+		//The row above the band, the row below it, and the 2 rows calculateRowsInPlace works with
+		std::vector<int> rowBuffers(4 * cols);
+		memcpy(rowBuffers.data(), currentGrid[firstRow - 1], cols * sizeof(int));
+		memcpy(rowBuffers.data() + cols, currentGrid[lastRow], cols * sizeof(int));
+
+		//Nobody can start overwriting rows until all the bands' neighbouring rows have been saved
+#pragma omp barrier
+
+		GenerationCounts counts = GenerationCounts();
+		if (firstRow < lastRow)
+			calculateRowsInPlace(firstRow, lastRow, rowBuffers.data(), rowBuffers.data() + cols, rowBuffers.data() + 2 * cols,
+				randomSharkDeaths ? 53 : 0, outputs, &counts);
+
+		if (outputs != nullptr && (outputs->collectCounts || outputs->collectLayoutHash))
+		{
+#pragma omp critical
+			addCounts(outputs->counts, counts);
+		}
+	}
 }
\ No newline at end of file
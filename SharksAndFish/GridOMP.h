@@ -1,4 +1,5 @@
 #pragma once
+#include"Autotuner.h"
 #include"Grid.h"
 
 /*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
@@ -7,12 +8,25 @@ These are represented by integers:
 < 0 = shark
 ==0 = water
 For sharks and fish, the absolute value of the integer corresponds to their age.
-eg- A cell with value -5 contains a 5-year-old shark.*/
+eg- A cell with value -5 contains a 5-year-old shark.
+
+The number of threads, the schedule and the number of rows handed out at a time can be set with setTuning, or picked
+by autotune.*/
 class GridOMP : public Grid
 {
 public:
-	GridOMP(int rows, int cols) : Grid(rows, cols) {};
-	void calculateNextGridState();
+	GridOMP(int rows, int cols, bool lowMemory = false);
+	void setTuning(const TuningConfig &config);
+	TuningConfig getTuning();
+	void autotune(Autotuner &autotuner);
+	void calculateNextGridState(GenerationOutputs *outputs = nullptr);
+	void goToNextGeneration(GenerationOutputs &outputs);
+	using Grid::showGridAsImage;
 	void showGridAsImage(std::string additionalInfo = "");
 	float runTest(int nIterations);
+
+protected:
+	TuningConfig tuning;
+
+	void calculateNextGridStateInPlace(GenerationOutputs *outputs);
 };
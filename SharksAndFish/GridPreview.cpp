@@ -0,0 +1,426 @@
+#include"stdafx.h"
+#include"GridPreview.h"
+#include"Grid.h"
+#include"InitialState.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<ctime>
+#include<iomanip>
+#include<iostream>
+#include<utility>
+#include<opencv2\opencv.hpp>
+
+//A shark dies of random causes with a chance of 1 in SHARK_DEATH_ODDS, as in Grid
+#define SHARK_DEATH_ODDS 32
+
+//The kinds of neighbour that make a difference to the rules: young and breeding fish, then young and breeding sharks
+//(water is what's left)
+enum NeighbourKind { youngFishNeighbour, breedingFishNeighbour, youngSharkNeighbour, breedingSharkNeighbour,
+	nNeighbourKinds };
+
+static int getState(int cell);
+
+//Instantiates a preview of a grid with the given number of rows and columns, in blocks of blockSize x blockSize cells,
+//with the same chances of a shark or a fish in every cell as Grid's initGrid(sharkPercent, fishPercent)
+GridPreview::GridPreview(int rows, int cols, int blockSize, int sharkPercent, int fishPercent)
+{
+	this->rows = rows;
+	this->cols = cols;
+	this->blockSize = std::max(blockSize, 1);
+	blocksDown = (rows + this->blockSize - 1) / this->blockSize;
+	blocksAcross = (cols + this->blockSize - 1) / this->blockSize;
+	currentBlocks.resize(static_cast<size_t>(blocksDown) * blocksAcross * nPreviewStates);
+	nextCalculatedBlocks.resize(currentBlocks.size());
+
+	//Out of the 8 neighbours of each of a block's cells, 3 * blockSize - 2 are in each block beside it, and 1 in each
+	//block diagonal to it; the rest are in the block itself
+	double nNeighbours = 8.0 * this->blockSize * this->blockSize;
+	sideWeight = (3.0 * this->blockSize - 2) / nNeighbours;
+	cornerWeight = 1 / nNeighbours;
+	ownWeight = 1 - 4 * sideWeight - 4 * cornerWeight;
+
+	fillUniformly(sharkPercent, fishPercent);
+}
+
+//Replaces the preview with the block averages of a grid of the same size, laid out like Grid's currentGrid (with
+//ghost cells), ages and all
+void GridPreview::loadGrid(int **grid)
+{
+	std::fill(currentBlocks.begin(), currentBlocks.end(), 0.0);
+	loadRows(grid, 0, rows);
+}
+
+//Replaces the preview with the block averages of a grid made from a density map or a pattern (see InitialState)
+//The grid is made a row of blocks at a time, so it never has to be all in memory. Returns false if the file couldn't
+//be read.
+bool GridPreview::loadInitialState(InitialState &state)
+{
+	std::fill(currentBlocks.begin(), currentBlocks.end(), 0.0);
+
+	std::vector<int> cells(static_cast<size_t>(blockSize + 2) * (cols + 2));
+	std::vector<int*> bandRows(blockSize + 2);
+	for (int row = 0; row < blockSize + 2; ++row)
+		bandRows[row] = cells.data() + static_cast<size_t>(row) * (cols + 2);
+
+	for (int firstRow = 0; firstRow < rows; firstRow += blockSize)
+	{
+		int nRows = std::min(blockSize, rows - firstRow);
+		if (!state.fill(bandRows.data(), nRows + 2, cols + 2, firstRow, rows))
+			return false;
+		loadRows(bandRows.data(), firstRow, nRows);
+	}
+	return true;
+}
+
+//Prints the grid's stats, such as the count of shark and fish; these are the numbers to expect, not whole cells
+void GridPreview::printStatsToConsole()
+{
+	double sharks, fish;
+	getPopulation(sharks, fish);
+	std::cout << std::fixed << std::setprecision(0) << "Number of sharks: " << sharks << "\nNumber of fish: " << fish;
+	std::cout << "\nNumber of water cells: " << static_cast<double>(rows) * cols - sharks - fish << std::defaultfloat
+		<< std::endl;
+}
+
+float GridPreview::runTest(int nIterations)
+{
+	float startTime = clock();
+	for (int i = 0; i < nIterations; ++i)
+	{
+		calculateNextGridState();
+		goToNextGridState();
+	}
+	return clock() - startTime;
+}
+
+//Applies the rules to the odds of every block and puts the results in the nextCalculatedBlocks
+void GridPreview::calculateNextGridState()
+{
+	int nBlocks = blocksDown * blocksAcross;
+
+	//The chance of a cell in each block being each kind of neighbour
+	std::vector<double> kindOdds(static_cast<size_t>(nBlocks) * nNeighbourKinds);
+#pragma omp parallel for
+	for (int block = 0; block < nBlocks; ++block)
+	{
+		const double *states = currentBlocks.data() + static_cast<size_t>(block) * nPreviewStates;
+		double *kinds = kindOdds.data() + static_cast<size_t>(block) * nNeighbourKinds;
+		kinds[youngFishNeighbour] = states[0];
+		kinds[breedingFishNeighbour] = 0;
+		for (int age = 2; age <= maxFishAge; ++age)
+			kinds[breedingFishNeighbour] += states[age - 1];
+		kinds[youngSharkNeighbour] = states[maxFishAge] + states[maxFishAge + 1];
+		kinds[breedingSharkNeighbour] = 0;
+		for (int age = 3; age <= maxSharkAge; ++age)
+			kinds[breedingSharkNeighbour] += states[maxFishAge + age - 1];
+	}
+
+	//The chance of a neighbour of a cell in each block being each kind, from the block and the 8 around it (wrapping
+	//around the edges of the grid the same way the ghost cells do)
+	std::vector<double> neighbourOdds(kindOdds.size());
+#pragma omp parallel for
+	for (int block = 0; block < nBlocks; ++block)
+	{
+		int blockRow = block / blocksAcross, blockCol = block % blocksAcross;
+		double *odds = neighbourOdds.data() + static_cast<size_t>(block) * nNeighbourKinds;
+		for (int kind = 0; kind < nNeighbourKinds; ++kind)
+			odds[kind] = 0;
+
+		for (int rowOffset = -1; rowOffset <= 1; ++rowOffset)
+		{
+			for (int colOffset = -1; colOffset <= 1; ++colOffset)
+			{
+				int otherBlock = (blockRow + rowOffset + blocksDown) % blocksDown * blocksAcross
+					+ (blockCol + colOffset + blocksAcross) % blocksAcross;
+				double weight = rowOffset == 0 && colOffset == 0 ? ownWeight
+					: rowOffset == 0 || colOffset == 0 ? sideWeight : cornerWeight;
+				const double *kinds = kindOdds.data() + static_cast<size_t>(otherBlock) * nNeighbourKinds;
+				for (int kind = 0; kind < nNeighbourKinds; ++kind)
+					odds[kind] += weight * kinds[kind];
+			}
+		}
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int block = 0; block < nBlocks; ++block)
+		calculateBlock(block, neighbourOdds);
+}
+
+//Makes the nextCalculatedBlocks current; they're swapped, not copied
+void GridPreview::goToNextGridState()
+{
+	std::swap(currentBlocks, nextCalculatedBlocks);
+}
+
+//Shows the preview as an image using OpenCV (displays the image in a new window), with each block coloured in by how
+//likely its cells are to hold water, a fish or a shark
+void GridPreview::showGridAsImage(std::string additionalInfo)
+{
+	using namespace cv;
+
+	Vec3b waterColour = Vec3b(255, 153, 153);	//light blue
+	Vec3b fishColour = Vec3b(102, 0, 204);		//maroon
+	Vec3b sharkColour = Vec3b(51, 255, 255);	//yellow
+
+	//Create the image (pixels will be empty)
+	Mat gridImage = Mat(rows, cols, CV_8UC3);
+
+	for (int block = 0; block < blocksDown * blocksAcross; ++block)
+	{
+		const double *states = currentBlocks.data() + static_cast<size_t>(block) * nPreviewStates;
+		double fish = 0, sharks = 0;
+		for (int state = 0; state < maxFishAge; ++state)
+			fish += states[state];
+		for (int state = maxFishAge; state < nPreviewStates; ++state)
+			sharks += states[state];
+		Vec3b colour;
+		for (int channel = 0; channel < 3; ++channel)
+			colour[channel] = static_cast<unsigned char>(waterColour[channel] * (1 - fish - sharks)
+				+ fishColour[channel] * fish + sharkColour[channel] * sharks);
+
+		int firstRow = block / blocksAcross * blockSize, firstCol = block % blocksAcross * blockSize;
+		for (int row = firstRow; row < std::min(firstRow + blockSize, rows); ++row)
+		{
+			for (int col = firstCol; col < std::min(firstCol + blockSize, cols); ++col)
+				gridImage.at<Vec3b>(row, col) = colour;
+		}
+	}
+
+	cv::imshow("Sharks and Fish (preview)" + std::string(" ") + additionalInfo, gridImage);
+	cv::waitKey(0);
+}
+
+//Returns the number of sharks and fish to expect in the whole grid
+void GridPreview::getPopulation(double &outSharks, double &outFish)
+{
+	outSharks = outFish = 0;
+	for (int block = 0; block < blocksDown * blocksAcross; ++block)
+	{
+		const double *states = currentBlocks.data() + static_cast<size_t>(block) * nPreviewStates;
+		int nCells = getBlockCells(block);
+		for (int state = 0; state < maxFishAge; ++state)
+			outFish += states[state] * nCells;
+		for (int state = maxFishAge; state < nPreviewStates; ++state)
+			outSharks += states[state] * nCells;
+	}
+}
+
+//Runs a Grid and a preview of it (with blocks of blockSize x blockSize cells) from the same random grid of rows x cols
+//cells for nIterations generations, and prints how far apart they are: the number of sharks and fish in each, and
+//the root mean square difference between their blocks' densities of sharks and fish, every so often and on average,
+//along with how long a generation takes in each
+void GridPreview::calibrate(int rows, int cols, int nIterations, int blockSize, int sharkPercent, int fishPercent)
+{
+	Grid grid(rows, cols);
+	grid.restart(rows, cols, sharkPercent, fishPercent);
+	GridPreview preview(rows, cols, blockSize);
+	preview.loadGrid(grid.currentGrid);
+
+	std::cout << "Preview calibration: " << rows << " x " << cols << " cells in blocks of " << preview.blockSize << " x "
+		<< preview.blockSize << ", starting with " << sharkPercent << "% sharks and " << fishPercent << "% fish\n";
+	std::cout << std::setw(10) << "generation" << std::setw(14) << "sharks" << std::setw(14) << "(preview)"
+		<< std::setw(14) << "fish" << std::setw(14) << "(preview)" << std::setw(18) << "block RMS error" << std::endl;
+
+	using Clock = std::chrono::steady_clock;
+	double gridSeconds = 0, previewSeconds = 0;
+	double totalSharkError = 0, totalFishError = 0, totalBlockError = 0;
+	int nBlocks = preview.blocksDown * preview.blocksAcross;
+	std::vector<double> gridSharks, gridFish;
+	for (int generation = 1; generation <= nIterations; ++generation)
+	{
+		Clock::time_point start = Clock::now();
+		grid.calculateNextGridState();
+		grid.goToNextGridState();
+		Clock::time_point gridEnd = Clock::now();
+		preview.calculateNextGridState();
+		preview.goToNextGridState();
+		Clock::time_point previewEnd = Clock::now();
+		gridSeconds += std::chrono::duration<double>(gridEnd - start).count();
+		previewSeconds += std::chrono::duration<double>(previewEnd - gridEnd).count();
+
+		//Compare the blocks' densities, and add them up into the whole grid's numbers
+		preview.getBlockDensities(grid.currentGrid, gridSharks, gridFish);
+		double sharks = 0, fish = 0, previewSharks = 0, previewFish = 0, squaredError = 0;
+		for (int block = 0; block < nBlocks; ++block)
+		{
+			const double *states = preview.currentBlocks.data() + static_cast<size_t>(block) * nPreviewStates;
+			double blockFish = 0, blockSharks = 0;
+			for (int state = 0; state < maxFishAge; ++state)
+				blockFish += states[state];
+			for (int state = maxFishAge; state < nPreviewStates; ++state)
+				blockSharks += states[state];
+
+			int nCells = preview.getBlockCells(block);
+			sharks += gridSharks[block] * nCells;
+			fish += gridFish[block] * nCells;
+			previewSharks += blockSharks * nCells;
+			previewFish += blockFish * nCells;
+			squaredError += (blockSharks - gridSharks[block]) * (blockSharks - gridSharks[block])
+				+ (blockFish - gridFish[block]) * (blockFish - gridFish[block]);
+		}
+		double blockError = std::sqrt(squaredError / (2.0 * nBlocks));
+
+		double nCells = static_cast<double>(rows) * cols;
+		totalSharkError += std::abs(previewSharks - sharks) / nCells;
+		totalFishError += std::abs(previewFish - fish) / nCells;
+		totalBlockError += blockError;
+		if (generation % std::max(nIterations / 10, 1) == 0 || generation == nIterations)
+		{
+			std::cout << std::setw(10) << generation << std::fixed << std::setprecision(0) << std::setw(14) << sharks
+				<< std::setw(14) << previewSharks << std::setw(14) << fish << std::setw(14) << previewFish
+				<< std::setprecision(4) << std::setw(18) << blockError << std::defaultfloat << std::endl;
+		}
+	}
+
+	int nGenerations = std::max(nIterations, 1);
+	std::cout << "Average error: " << 100 * totalSharkError / nGenerations << "% of the cells for sharks, "
+		<< 100 * totalFishError / nGenerations << "% for fish; block RMS error " << totalBlockError / nGenerations << "\n";
+	std::cout << "Time per generation: " << 1000 * gridSeconds / nGenerations << " ms for the grid, "
+		<< 1000 * previewSeconds / nGenerations << " ms for the preview ("
+		<< (previewSeconds > 0 ? gridSeconds / previewSeconds : 0) << " times faster)" << std::endl;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Gives every block the chances of a shark (of age 1) and a fish (of age 1) that initGrid gives every cell
+void GridPreview::fillUniformly(int sharkPercent, int fishPercent)
+{
+	std::fill(currentBlocks.begin(), currentBlocks.end(), 0.0);
+	for (size_t block = 0; block < currentBlocks.size() / nPreviewStates; ++block)
+	{
+		currentBlocks[block * nPreviewStates] = fishPercent / 100.0;
+		currentBlocks[block * nPreviewStates + maxFishAge] = sharkPercent / 100.0;
+	}
+}
+
+//Adds nRows rows of a grid (with ghost cells, so they're grid[1] to grid[nRows]), which are rows firstRow on of the
+//whole grid, into the blocks they're in; firstRow has to be at the top of a block, and a block's rows all have to
+//be added before it's used
+void GridPreview::loadRows(int **grid, int firstRow, int nRows)
+{
+	for (int row = 0; row < nRows; ++row)
+	{
+		int blockRow = (firstRow + row) / blockSize;
+		for (int col = 0; col < cols; ++col)
+		{
+			int state = getState(grid[row + 1][col + 1]);
+			if (state < 0)
+				continue;
+			int block = blockRow * blocksAcross + col / blockSize;
+			currentBlocks[static_cast<size_t>(block) * nPreviewStates + state] += 1.0 / getBlockCells(block);
+		}
+	}
+}
+
+//Works out the odds of a block's cells in the next generation from their odds now and the odds of their neighbours
+//being of each kind (neighbourOdds, see calculateNextGridState)
+//The chances of the rules applying come from adding up the chances of every way the 8 neighbours can be split
+//between the kinds (495 of them), each of which is a multinomial probability.
+void GridPreview::calculateBlock(int block, const std::vector<double> &neighbourOdds)
+{
+	const double *odds = neighbourOdds.data() + static_cast<size_t>(block) * nNeighbourKinds;
+	const double *states = currentBlocks.data() + static_cast<size_t>(block) * nPreviewStates;
+	double *nextStates = nextCalculatedBlocks.data() + static_cast<size_t>(block) * nPreviewStates;
+
+	//Each kind's odds (and water's, last) raised to the power of 0 to 8
+	double kindOdds[nNeighbourKinds + 1];
+	double water = 1;
+	for (int kind = 0; kind < nNeighbourKinds; ++kind)
+	{
+		kindOdds[kind] = std::max(odds[kind], 0.0);
+		water -= kindOdds[kind];
+	}
+	kindOdds[nNeighbourKinds] = std::max(water, 0.0);
+	double powers[nNeighbourKinds + 1][9];
+	for (int kind = 0; kind <= nNeighbourKinds; ++kind)
+	{
+		powers[kind][0] = 1;
+		for (int power = 1; power <= 8; ++power)
+			powers[kind][power] = powers[kind][power - 1] * kindOdds[kind];
+	}
+	const double factorials[9] = { 1, 1, 2, 6, 24, 120, 720, 5040, 40320 };
+
+	double fishBirth = 0, sharkBirth = 0, fishDeath = 0, sharkStarvation = 0;
+	for (int nBreedingFish = 0; nBreedingFish <= 8; ++nBreedingFish)
+	{
+		for (int nYoungFish = 0; nBreedingFish + nYoungFish <= 8; ++nYoungFish)
+		{
+			int nFish = nBreedingFish + nYoungFish;
+			for (int nBreedingSharks = 0; nFish + nBreedingSharks <= 8; ++nBreedingSharks)
+			{
+				for (int nYoungSharks = 0; nFish + nBreedingSharks + nYoungSharks <= 8; ++nYoungSharks)
+				{
+					int nSharks = nBreedingSharks + nYoungSharks;
+					int nWater = 8 - nFish - nSharks;
+					double chance = factorials[8] / (factorials[nYoungFish] * factorials[nBreedingFish]
+						* factorials[nYoungSharks] * factorials[nBreedingSharks] * factorials[nWater])
+						* powers[youngFishNeighbour][nYoungFish] * powers[breedingFishNeighbour][nBreedingFish]
+						* powers[youngSharkNeighbour][nYoungSharks] * powers[breedingSharkNeighbour][nBreedingSharks]
+						* powers[nNeighbourKinds][nWater];
+
+					//The same rules as Grid::calculateRows
+					if (nFish >= 4 && nBreedingFish >= 3 && nSharks < 4)
+						fishBirth += chance;
+					else if (nSharks >= 4 && nBreedingSharks >= 3 && nFish < 4)
+						sharkBirth += chance;
+					if (nSharks >= 5 || nFish == 8)
+						fishDeath += chance;
+					if (nSharks >= 6 && nFish == 0)
+						sharkStarvation += chance;
+				}
+			}
+		}
+	}
+
+	//Empty cells may get a fish or a shark; the rest age by a year if they survive, unless they're as old as they get
+	double emptyCells = 1;
+	for (int state = 0; state < nPreviewStates; ++state)
+		emptyCells -= states[state];
+	emptyCells = std::max(emptyCells, 0.0);
+
+	double sharkSurvival = (1 - sharkStarvation) * (SHARK_DEATH_ODDS - 1) / SHARK_DEATH_ODDS;
+	nextStates[0] = emptyCells * fishBirth;
+	for (int age = 2; age <= maxFishAge; ++age)
+		nextStates[age - 1] = states[age - 2] * (1 - fishDeath);
+	nextStates[maxFishAge] = emptyCells * sharkBirth;
+	for (int age = 2; age <= maxSharkAge; ++age)
+		nextStates[maxFishAge + age - 1] = states[maxFishAge + age - 2] * sharkSurvival;
+}
+
+//Returns the number of cells in a block (the blocks at the bottom and right of the grid may be cut short)
+int GridPreview::getBlockCells(int block)
+{
+	int firstRow = block / blocksAcross * blockSize, firstCol = block % blocksAcross * blockSize;
+	return (std::min(firstRow + blockSize, rows) - firstRow) * (std::min(firstCol + blockSize, cols) - firstCol);
+}
+
+//Works out the share of each block's cells that hold sharks and fish in a grid of the same size, laid out like Grid's
+//currentGrid
+void GridPreview::getBlockDensities(int **grid, std::vector<double> &outSharks, std::vector<double> &outFish)
+{
+	outSharks.assign(static_cast<size_t>(blocksDown) * blocksAcross, 0.0);
+	outFish.assign(outSharks.size(), 0.0);
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int block = row / blockSize * blocksAcross + col / blockSize;
+			if (grid[row + 1][col + 1] > 0)
+				outFish[block] += 1.0 / getBlockCells(block);
+			else if (grid[row + 1][col + 1] < 0)
+				outSharks[block] += 1.0 / getBlockCells(block);
+		}
+	}
+}
+
+//Returns the state (see nPreviewStates) of a cell's value, or -1 for water
+static int getState(int cell)
+{
+	if (cell > 0)
+		return std::min(cell, maxFishAge) - 1;
+	if (cell < 0)
+		return maxFishAge + std::min(-cell, maxSharkAge) - 1;
+	return -1;
+}
\ No newline at end of file
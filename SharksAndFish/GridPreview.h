@@ -0,0 +1,52 @@
+#pragma once
+#include"Grid.h"
+#include<string>
+#include<vector>
+
+class InitialState;
+
+//The number of states a cell can be in besides water: a fish of each age, then a shark of each age
+constexpr int nPreviewStates = maxFishAge + maxSharkAge;
+
+/*A rough, fast version of a grid, for a quick look at how a size, a mix of sharks and fish or an initial state
+behaves before running it for real.
+Instead of cells, it keeps square blocks of blockSize x blockSize cells, and only how likely a cell in each block is
+to hold a fish or a shark of each age. Each generation, the cells of a block are taken to be independent, with their
+8 neighbours drawn from their own block and the blocks around it (each in proportion to how many of a block's cells'
+neighbours are in it), and the rules of Grid::calculateNextGridState are applied to those odds: the chance of a fish
+or a shark being born in an empty cell, of a fish being eaten or overcrowded, and of a shark starving or dying at
+random, all from the chances of each count of neighbours. Ageing and dying of old age are exact.
+
+This ignores how a cell's neighbours depend on each other and on the cell, so patterns smaller than a block are lost
+and the numbers drift from the real ones; calibrate runs both on a small grid to show by how much. A generation costs
+about the same for a block as for a few cells of a Grid, so the bigger the blocks, the faster it is.*/
+class GridPreview
+{
+public:
+	GridPreview(int rows, int cols, int blockSize = 32, int sharkPercent = 25, int fishPercent = 50);
+	void loadGrid(int **grid);
+	bool loadInitialState(InitialState &state);
+	void printStatsToConsole();
+	float runTest(int nIterations);
+	void calculateNextGridState();
+	void goToNextGridState();
+	void showGridAsImage(std::string additionalInfo = "");
+	void getPopulation(double &outSharks, double &outFish);
+	static void calibrate(int rows, int cols, int nIterations, int blockSize = 32, int sharkPercent = 25,
+		int fishPercent = 50);
+
+protected:
+	//rows and cols don't include ghost cells
+	int rows, cols;
+	int blockSize, blocksDown, blocksAcross;
+	//Each block's chance of a cell being in each state (see nPreviewStates), block by block; water is what's left
+	std::vector<double> currentBlocks, nextCalculatedBlocks;
+	//How many of a block's cells' neighbours are in the block itself, in a block next to it, and in one diagonal to it
+	double ownWeight, sideWeight, cornerWeight;
+
+	void fillUniformly(int sharkPercent, int fishPercent);
+	void loadRows(int **grid, int firstRow, int nRows);
+	void calculateBlock(int block, const std::vector<double> &neighbourOdds);
+	int getBlockCells(int block);
+	void getBlockDensities(int **grid, std::vector<double> &outSharks, std::vector<double> &outFish);
+};
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include"stdafx.h"
+#include"GridSparse.h"
+#include"Utils.h"
+
+#include<cstring>
+#include<ctime>
+#include<iostream>
+#include<utility>
+
+//Number of chunks the pool allocates at once when it runs out
+#define CHUNKS_PER_BLOCK 64
+
+//Instantiates a grid and fills the cells in rows 0 to rows - 1 and columns 0 to cols - 1 with values
+//Everything outside that area starts off as water
+GridSparse::GridSparse(int rows, int cols)
+{
+	initGrid(rows, cols, 25, 50);
+}
+
+//Prints the grid's stats, such as the count of shark and fish
+//There's no water count, since the ocean is endless; the number of chunks in use is printed instead
+void GridSparse::printStatsToConsole()
+{
+	long long sharkCount = 0, fishCount = 0;
+	for (auto &entry : currentChunks)
+	{
+		for (int cell : entry.second->cells)
+		{
+			if (cell > 0)
+				++fishCount;
+			else if (cell < 0)
+				++sharkCount;
+		}
+	}
+
+	std::cout << "Number of sharks: " << sharkCount << "\nNumber of fish: " << fishCount;
+	std::cout << "\nNumber of chunks in use: " << currentChunks.size() << std::endl;
+}
+
+//Runs the grid according to the rules for nIterations, and returns the time it took to complete
+float GridSparse::runTest(int nIterations)
+{
+	float startTime = clock();
+	for (int i = 0; i < nIterations; ++i)
+	{
+		calculateNextGridState();
+		goToNextGridState();
+	}
+	return clock() - startTime;
+}
+
+//Evaluates the rules of the celluar automata and puts values in the nextCalculatedChunks based on them
+//Only the chunks in use and the ones right next to them can have anything in them in the next state, since a fish or
+//shark can only be born next to others of its kind
+void GridSparse::calculateNextGridState()
+{
+	visitedChunks.clear();
+	for (auto &entry : currentChunks)
+	{
+		for (int dRow = -1; dRow <= 1; ++dRow)
+		{
+			for (int dCol = -1; dCol <= 1; ++dCol)
+			{
+				int chunkRow = entry.second->row + dRow;
+				int chunkCol = entry.second->col + dCol;
+				long long key = getChunkKey(chunkRow, chunkCol);
+				if (!visitedChunks.insert(key).second)
+					continue;
+
+				//Chunks with nothing in or around them stay empty
+				if (!fillPaddedChunk(chunkRow, chunkCol))
+					continue;
+
+				Chunk *chunk = acquireChunk();
+				chunk->row = chunkRow;
+				chunk->col = chunkCol;
+				if (calculateChunk(chunk))
+					nextCalculatedChunks[key] = chunk;
+				else
+					releaseChunk(chunk);
+			}
+		}
+	}
+}
+
+//Makes the nextCalculatedChunks the current ones, and returns the old ones to the pool
+void GridSparse::goToNextGridState()
+{
+	for (auto &entry : currentChunks)
+		releaseChunk(entry.second);
+	currentChunks.clear();
+	std::swap(currentChunks, nextCalculatedChunks);
+}
+
+//Returns the value of the cell at the given row and column
+int GridSparse::getCell(int row, int col)
+{
+	Chunk *chunk = findChunk(getChunkIndex(row), getChunkIndex(col));
+	if (chunk == nullptr)
+		return 0;
+	return chunk->cells[(row - chunk->row * chunkSize) * chunkSize + col - chunk->col * chunkSize];
+}
+
+//Sets the value of the cell at the given row and column, adding a chunk for it if needed
+void GridSparse::setCell(int row, int col, int value)
+{
+	int chunkRow = getChunkIndex(row), chunkCol = getChunkIndex(col);
+	Chunk *chunk = findChunk(chunkRow, chunkCol);
+	if (chunk == nullptr)
+	{
+		//No need for a chunk just to hold water
+		if (value == 0)
+			return;
+
+		chunk = acquireChunk();
+		chunk->row = chunkRow;
+		chunk->col = chunkCol;
+		memset(chunk->cells, 0, sizeof(chunk->cells));
+		currentChunks[getChunkKey(chunkRow, chunkCol)] = chunk;
+	}
+	chunk->cells[(row - chunkRow * chunkSize) * chunkSize + col - chunkCol * chunkSize] = value;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Initializes the given area of the grid and tries to keep the percentage of sharks, fish, and water cells as specified
+//in the parameters
+//Both the parameters must be between 0 and 100, and their sum must not exceed 100
+//Cells are drawn in the same order as Grid::initGrid, so the same seed gives the same starting area
+void GridSparse::initGrid(int rows, int cols, int sharkPercent, int fishPercent)
+{
+	int sharkUpperLimit = sharkPercent;
+	int fishUpperLimit = sharkPercent + fishPercent;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int temp = Utils::getRandomNumber(1, 100);
+			if (temp <= sharkUpperLimit)
+				setCell(row, col, -1);	//shark
+			else if (temp <= fishUpperLimit)
+				setCell(row, col, 1);	//fish
+		}
+	}
+}
+
+//Takes a chunk from the pool, allocating a new block of them if the pool is empty
+//The chunk's cells are not cleared
+GridSparse::Chunk *GridSparse::acquireChunk()
+{
+	if (freeChunks.empty())
+	{
+		chunkBlocks.emplace_back(new Chunk[CHUNKS_PER_BLOCK]);
+		for (int i = 0; i < CHUNKS_PER_BLOCK; ++i)
+			freeChunks.push_back(&chunkBlocks.back()[i]);
+	}
+
+	Chunk *chunk = freeChunks.back();
+	freeChunks.pop_back();
+	return chunk;
+}
+
+//Returns a chunk to the pool
+void GridSparse::releaseChunk(Chunk *chunk)
+{
+	freeChunks.push_back(chunk);
+}
+
+//Combines a chunk's row and column into the key it is stored under
+long long GridSparse::getChunkKey(int chunkRow, int chunkCol)
+{
+	unsigned long long key = static_cast<unsigned long long>(static_cast<unsigned int>(chunkRow)) << 32;
+	key |= static_cast<unsigned int>(chunkCol);
+	return static_cast<long long>(key);
+}
+
+//Returns the index of the chunk a row or column of cells falls in; rounds down for negative values as well
+int GridSparse::getChunkIndex(int cellIndex)
+{
+	return cellIndex >= 0 ? cellIndex / chunkSize : -((-(cellIndex + 1)) / chunkSize) - 1;
+}
+
+//Returns the chunk at the given chunk row and column, or nullptr if it isn't in use
+GridSparse::Chunk *GridSparse::findChunk(int chunkRow, int chunkCol)
+{
+	auto found = currentChunks.find(getChunkKey(chunkRow, chunkCol));
+	return found == currentChunks.end() ? nullptr : found->second;
+}
+
+//Copies the cells of the chunk at the given chunk row and column into paddedChunk, along with the ring of cells
+//around it from its neighbours (chunks not in use count as water)
+//Returns false if all of them are water
+bool GridSparse::fillPaddedChunk(int chunkRow, int chunkCol)
+{
+	bool isPopulated = false;
+	for (int dRow = -1; dRow <= 1; ++dRow)
+	{
+		for (int dCol = -1; dCol <= 1; ++dCol)
+		{
+			Chunk *neighbour = findChunk(chunkRow + dRow, chunkCol + dCol);
+
+			//The part of paddedChunk this chunk covers, and where that part starts in the chunk
+			int firstRow = dRow < 0 ? 0 : (dRow == 0 ? 1 : chunkSize + 1);
+			int firstCol = dCol < 0 ? 0 : (dCol == 0 ? 1 : chunkSize + 1);
+			int nRows = dRow == 0 ? chunkSize : 1;
+			int nCols = dCol == 0 ? chunkSize : 1;
+			int sourceRow = dRow < 0 ? chunkSize - 1 : 0;
+			int sourceCol = dCol < 0 ? chunkSize - 1 : 0;
+
+			for (int row = 0; row < nRows; ++row)
+			{
+				int *destination = paddedChunk + (firstRow + row) * (chunkSize + 2) + firstCol;
+				if (neighbour == nullptr)
+				{
+					memset(destination, 0, nCols * sizeof(int));
+					continue;
+				}
+
+				const int *source = neighbour->cells + (sourceRow + row) * chunkSize + sourceCol;
+				for (int col = 0; col < nCols; ++col)
+				{
+					destination[col] = source[col];
+					isPopulated = isPopulated || source[col] != 0;
+				}
+			}
+		}
+	}
+	return isPopulated;
+}
+
+//Applies the rules to the cells in paddedChunk and puts the results in the given chunk
+//Returns false if the chunk ends up with nothing but water
+bool GridSparse::calculateChunk(Chunk *chunk)
+{
+	bool isPopulated = false;
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+	//In the for loops, the first and last row and column are excluded because they belong to the neighbouring chunks
+	for (int row = 1; row < chunkSize + 1; ++row)
+	{
+		const int *source = paddedChunk + row * (chunkSize + 2);
+		int *destination = chunk->cells + (row - 1) * chunkSize;
+		for (int col = 1; col < chunkSize + 1; ++col)
+		{
+			//Get the neighbours' counts
+			getNeighbourCount(row, col, nSharkNeighbours, nFishNeighbours);
+			nBreedingFish = nFishNeighbours % 10;
+			nBreedingSharks = nSharkNeighbours % 10;
+			nFishNeighbours /= 10;
+			nSharkNeighbours /= 10;
+
+			if (source[col] == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					destination[col - 1] = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					destination[col - 1] = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					destination[col - 1] = 0;
+			}
+			else if (source[col] > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					destination[col - 1] = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					destination[col - 1] = 0;
+				else if (source[col] == 10)	//max age reached; fish dies
+					destination[col - 1] = 0;
+				else	//nothing happens to the fish
+					destination[col - 1] = source[col] + 1;	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					destination[col - 1] = 0;
+				else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
+					destination[col - 1] = 0;
+				else if (source[col] == -20)	//reached max age; shark dies
+					destination[col - 1] = 0;
+				else	//nothing happens, shark survives; increment age
+					destination[col - 1] = source[col] - 1;
+			}
+
+			isPopulated = isPopulated || destination[col - 1] != 0;
+		}
+	}
+	return isPopulated;
+}
+
+//Same as Grid::getNeighbourCount, but for a cell in paddedChunk
+void GridSparse::getNeighbourCount(int row, int col, int &outSharkCount, int &outFishCount)
+{
+	outFishCount = 0;
+	outSharkCount = 0;
+	int breedingFishCount = 0, breedingSharkCount = 0;
+
+	int currentValue;
+	//check cells around the [row][col] cell (excluding the cell itself)
+	for (int iRow = row - 1; iRow <= row + 1; ++iRow)
+	{
+		for (int iCol = col - 1; iCol <= col + 1; ++iCol)
+		{
+			if (iRow == row && iCol == col)
+				continue;
+
+			currentValue = paddedChunk[iRow * (chunkSize + 2) + iCol];
+			if (currentValue > 0)	//fish
+			{
+				++outFishCount;
+				if (currentValue >= 2)	//breeding age
+					++breedingFishCount;
+			}
+			else if (currentValue < 0)	//shark
+			{
+				++outSharkCount;
+				if (currentValue <= -3)	//breeding age
+					++breedingSharkCount;
+			}
+		}
+	}
+
+	outFishCount = (outFishCount * 10) + breedingFishCount;
+	outSharkCount = (outSharkCount * 10) + breedingSharkCount;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include<memory>
+#include<unordered_map>
+#include<unordered_set>
+#include<vector>
+
+/*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
+These are represented by integers:
+> 0 = fish
+< 0 = shark
+==0 = water
+For sharks and fish, the absolute value of the integer corresponds to their age.
+eg- A cell with value -5 contains a 5-year-old shark.
+
+Unlike the other grids, this one has no edges and doesn't wrap around: the ocean goes on forever in every direction.
+It is stored as a hash map of square chunks of chunkSize x chunkSize cells, and only chunks with at least one shark
+or fish in them are kept, so memory and time depend on how much of the ocean is populated rather than on its extent.
+Chunks are recycled through a pool instead of being freed.*/
+class GridSparse
+{
+public:
+	//The number of rows and columns of cells in a chunk
+	static constexpr int chunkSize = 32;
+
+	GridSparse(int rows, int cols);
+	void printStatsToConsole();
+	float runTest(int nIterations);
+	void calculateNextGridState();
+	void goToNextGridState();
+	int getCell(int row, int col);
+	void setCell(int row, int col, int value);
+
+protected:
+	//The cells in rows row * chunkSize to row * chunkSize + chunkSize - 1, and the same for the columns
+	struct Chunk
+	{
+		int row, col;
+		int cells[chunkSize * chunkSize];
+	};
+
+	std::unordered_map<long long, Chunk*> currentChunks, nextCalculatedChunks;
+	//Chunks already looked at while calculating the next state
+	std::unordered_set<long long> visitedChunks;
+	//A chunk's cells plus a ring of cells from its neighbours, to calculate it without looking anything up
+	int paddedChunk[(chunkSize + 2) * (chunkSize + 2)];
+
+	//The pool: chunks are allocated in blocks and handed out from freeChunks
+	std::vector<std::unique_ptr<Chunk[]>> chunkBlocks;
+	std::vector<Chunk*> freeChunks;
+
+	void initGrid(int rows, int cols, int sharkPercent, int fishPercent);
+	Chunk *acquireChunk();
+	void releaseChunk(Chunk *chunk);
+	long long getChunkKey(int chunkRow, int chunkCol);
+	int getChunkIndex(int cellIndex);
+	Chunk *findChunk(int chunkRow, int chunkCol);
+	bool fillPaddedChunk(int chunkRow, int chunkCol);
+	bool calculateChunk(Chunk *chunk);
+	void getNeighbourCount(int row, int col, int &outSharkCount, int &outFishCount);
+};
\ No newline at end of file
@@ -0,0 +1,420 @@
+#include"stdafx.h"
+#include"GridStream.h"
+#include"Utils.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<ctime>
+#include<iostream>
+#include<utility>
+#include<omp.h>
+
+#define N_THREADS 12
+//Roughly how many bytes each band buffer may take; the number of rows in a band is worked out from this
+#define BAND_BYTES (64 * 1024 * 1024)
+
+//Instantiates a grid with the given number of rows and columns, stored in the file at filePath
+//A second file, filePath + ".next", is used for the generation being calculated. Up to fusedGenerations generations
+//are calculated per pass over the file. With loadExistingFile set, the grid starts from the one already in filePath
+//(as left by an earlier run of the same size) instead of a random one.
+GridStream::GridStream(int rows, int cols, std::string filePath, int fusedGenerations, bool loadExistingFile)
+{
+	this->rows = rows;
+	this->cols = cols;
+	this->fusedGenerations = std::max(fusedGenerations, 1);
+	this->filePath = filePath;
+	currentFilePath = filePath;
+	nextFilePath = filePath + ".next";
+
+	//Every row in memory gets a ghost cell at each end
+	long long rowBytes = static_cast<long long>(cols + 2) * sizeof(int);
+	bandRows = static_cast<int>(std::min<long long>(std::max<long long>(BAND_BYTES / rowBytes, 1), rows));
+
+	size_t inputBandSize = static_cast<size_t>(bandRows + 2 * this->fusedGenerations) * (cols + 2);
+	size_t outputBandSize = static_cast<size_t>(bandRows) * (cols + 2);
+	for (int i = 0; i < 2; ++i)
+	{
+		inputBands[i].resize(inputBandSize);
+		outputBands[i].resize(outputBandSize);
+		if (this->fusedGenerations > 1)
+			workBands[i].resize(inputBandSize);
+	}
+
+	openFiles(loadExistingFile);
+
+	//Fill the grid with values
+	if (!loadExistingFile)
+		initFile(25, 50);
+
+	//The sharks' random deaths come from the same seed as the grid (see isRandomSharkDeath)
+	seed = static_cast<unsigned long long>(Utils::getRandomNumber(0, 1 << 30)) << 30 | Utils::getRandomNumber(0, 1 << 30);
+	generation = 0;
+}
+
+//Closes the files and deletes the one used for calculating, leaving the grid's final state in filePath
+GridStream::~GridStream()
+{
+	currentFile.close();
+	nextFile.close();
+	std::remove(nextFilePath.c_str());
+	//After an odd number of passes the grid is in the other file, and the one just removed was filePath
+	if (currentFilePath != filePath && std::rename(currentFilePath.c_str(), filePath.c_str()) != 0)
+		std::cout << "Could not move the grid from " << currentFilePath << " to " << filePath << "!" << std::endl;
+}
+
+//Prints the grid's stats, such as the count of shark and fish
+void GridStream::printStatsToConsole()
+{
+	if (!filesOpen)
+		return;
+
+	long long sharkCount = 0, fishCount = 0, waterCount = 0;
+
+	//Go through the file one band at a time
+	for (int firstRow = 0; firstRow < rows; firstRow += bandRows)
+	{
+		int nBandRows = std::min(bandRows, rows - firstRow);
+		if (!readRows(firstRow, nBandRows, inputBands[0].data()))
+			return;
+		for (int row = 0; row < nBandRows; ++row)
+		{
+			const int *cells = inputBands[0].data() + static_cast<size_t>(row) * (cols + 2);
+			for (int col = 1; col < cols + 1; ++col)
+			{
+				if (cells[col] > 0)
+					++fishCount;
+				else if (cells[col] < 0)
+					++sharkCount;
+				else
+					++waterCount;
+			}
+		}
+	}
+
+	std::cout << "Number of sharks: " << sharkCount << "\nNumber of fish: " << fishCount;
+	std::cout << "\nNumber of water cells: " << waterCount << std::endl;
+}
+
+//Runs the grid according to the rules for nIterations, and returns the time it took to complete
+float GridStream::runTest(int nIterations)
+{
+	float startTime = clock();
+	for (int i = 0; i < nIterations; i += fusedGenerations)
+		runPass(std::min(fusedGenerations, nIterations - i));
+	return clock() - startTime;
+}
+
+//Calculates the next generation and makes it the current one
+//Unlike the in-memory grids, there's no separate step for going to the next state; the files swap places at the end
+//of every pass
+void GridStream::calculateNextGridState()
+{
+	runPass(1);
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Opens (and empties) the two files the grid is kept in; with loadExistingFile set, the current file is kept as it is
+//instead, and has to hold a grid of this size
+void GridStream::openFiles(bool loadExistingFile)
+{
+	std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+	currentFile.open(currentFilePath, loadExistingFile ? mode : mode | std::ios::trunc);
+	nextFile.open(nextFilePath, mode | std::ios::trunc);
+
+	filesOpen = currentFile.is_open() && nextFile.is_open();
+	if (!filesOpen)
+	{
+		std::cout << "Could not open " << currentFilePath << " and " << nextFilePath << " for the grid!" << std::endl;
+		return;
+	}
+
+	if (loadExistingFile)
+	{
+		currentFile.seekg(0, std::ios::end);
+		long long fileSize = static_cast<long long>(currentFile.tellg());
+		if (fileSize != static_cast<long long>(rows) * cols * sizeof(int))
+		{
+			std::cout << currentFilePath << " doesn't hold a " << rows << " x " << cols << " grid!" << std::endl;
+			filesOpen = false;
+		}
+	}
+}
+
+//Writes the initial grid to the current file, one row at a time
+//Cells are drawn in the same order as Grid::initGrid, so the same seed gives the same starting grid
+void GridStream::initFile(int sharkPercent, int fishPercent)
+{
+	if (!filesOpen)
+		return;
+
+	int sharkUpperLimit = sharkPercent;
+	int fishUpperLimit = sharkPercent + fishPercent;
+
+	std::vector<int> row(cols);
+	for (int iRow = 0; iRow < rows; ++iRow)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int temp = Utils::getRandomNumber(1, 100);
+			if (temp <= sharkUpperLimit)
+				row[col] = -1;	//shark
+			else if (temp <= fishUpperLimit)
+				row[col] = 1;	//fish
+			else
+				row[col] = 0;	//water
+		}
+		currentFile.write(reinterpret_cast<const char*>(row.data()), cols * sizeof(int));
+	}
+	currentFile.flush();
+
+	if (!currentFile)
+	{
+		std::cout << "Could not write the grid to " << currentFilePath << "!" << std::endl;
+		filesOpen = false;
+	}
+}
+
+//Calculates nGenerations generations in one pass over the current file, writing the result to the next file, and
+//then swaps the two
+//Each band is read with nGenerations extra rows on either side, which is enough to calculate its own rows that many
+//generations ahead without looking at the other bands. The I/O thread writes out band - 1 and reads in band + 1
+//while band is being calculated.
+void GridStream::runPass(int nGenerations)
+{
+	if (!filesOpen || nGenerations <= 0)
+		return;
+
+	int nBands = (rows + bandRows - 1) / bandRows;
+	auto getBandSize = [this](int band) { return std::min(bandRows, rows - band * bandRows); };
+
+	std::future<bool> io = std::async(std::launch::async, [&]()
+	{
+		return readRows(-nGenerations, getBandSize(0) + 2 * nGenerations, inputBands[0].data());
+	});
+
+	for (int band = 0; band < nBands; ++band)
+	{
+		//Wait for this band to be read in, and for the band before the previous one to be written out
+		//If either failed, the pass is abandoned, leaving the current file as it was
+		if (!io.get())
+		{
+			filesOpen = false;
+			return;
+		}
+
+		io = std::async(std::launch::async, [&, band]()
+		{
+			if (band > 0 && !writeRows((band - 1) * bandRows, getBandSize(band - 1), outputBands[(band - 1) % 2].data()))
+				return false;
+			if (band + 1 < nBands)
+			{
+				return readRows((band + 1) * bandRows - nGenerations, getBandSize(band + 1) + 2 * nGenerations,
+					inputBands[(band + 1) % 2].data());
+			}
+			return true;
+		});
+
+		calculateBand(inputBands[band % 2].data(), band * bandRows - nGenerations, getBandSize(band), nGenerations,
+			outputBands[band % 2].data());
+	}
+
+	if (!io.get() || !writeRows((nBands - 1) * bandRows, getBandSize(nBands - 1), outputBands[(nBands - 1) % 2].data()))
+	{
+		filesOpen = false;
+		return;
+	}
+	nextFile.flush();
+
+	std::swap(currentFile, nextFile);
+	std::swap(currentFilePath, nextFilePath);
+	generation += nGenerations;
+}
+
+//Reads nRows rows from the current file, starting at firstRow, into destination (leaving room for the ghost cells)
+//Rows before the first row or after the last one wrap around to the other end of the grid. Returns false, and says
+//so, if they couldn't all be read.
+bool GridStream::readRows(int firstRow, int nRows, int *destination)
+{
+	int previousFileRow = -1;
+	for (int i = 0; i < nRows; ++i)
+	{
+		int fileRow = ((firstRow + i) % rows + rows) % rows;
+		//Only seek when the rows stop being consecutive in the file
+		if (i == 0 || fileRow != previousFileRow + 1)
+			currentFile.seekg(static_cast<std::streamoff>(fileRow) * cols * sizeof(int));
+		currentFile.read(reinterpret_cast<char*>(destination + static_cast<size_t>(i) * (cols + 2) + 1), cols * sizeof(int));
+		previousFileRow = fileRow;
+	}
+
+	if (!currentFile)
+	{
+		std::cout << "Could not read rows " << firstRow << " to " << firstRow + nRows - 1 << " from " << currentFilePath
+			<< "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//Writes nRows rows from source (ignoring the ghost cells) to the next file, starting at firstRow
+//Returns false, and says so, if they couldn't all be written
+bool GridStream::writeRows(int firstRow, int nRows, const int *source)
+{
+	nextFile.seekp(static_cast<std::streamoff>(firstRow) * cols * sizeof(int));
+	for (int i = 0; i < nRows; ++i)
+		nextFile.write(reinterpret_cast<const char*>(source + static_cast<size_t>(i) * (cols + 2) + 1), cols * sizeof(int));
+
+	if (!nextFile)
+	{
+		std::cout << "Could not write rows " << firstRow << " to " << firstRow + nRows - 1 << " to " << nextFilePath
+			<< "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//Calculates nGenerations generations of a band that was read in with nGenerations extra rows on either side, and puts
+//the last one in outputBand; firstGridRow is the row of the grid the band's first row is (before wrapping around)
+//Every generation is one row shorter at each end than the one before it, since the outermost rows don't have all
+//their neighbours. The extra rows are also calculated by the neighbouring bands, which get the same results for them,
+//since the random shark deaths only depend on the cell and the generation, so a fused pass is exactly the same as
+//that many single-generation passes.
+void GridStream::calculateBand(int *inputBand, int firstGridRow, int nBandRows, int nGenerations, int *outputBand)
+{
+	int bandHeight = nBandRows + 2 * nGenerations;
+	int *sourceBand = inputBand;
+	for (int generation = 1; generation <= nGenerations; ++generation)
+	{
+		//Ghost columns for the rows that are still valid
+		for (int row = generation - 1; row < bandHeight - generation + 1; ++row)
+		{
+			int *cells = sourceBand + static_cast<size_t>(row) * (cols + 2);
+			cells[0] = cells[cols];
+			cells[cols + 1] = cells[1];
+		}
+
+		int firstRow = generation, lastRow = bandHeight - generation;
+		int sourceGeneration = this->generation + generation - 1;
+		if (generation == nGenerations)
+		{
+			calculateRows(sourceBand, firstGridRow, sourceGeneration, firstRow, lastRow, outputBand);
+		}
+		else
+		{
+			int *destinationBand = workBands[generation % 2].data();
+			calculateRows(sourceBand, firstGridRow, sourceGeneration, firstRow, lastRow,
+				destinationBand + static_cast<size_t>(firstRow) * (cols + 2));
+			sourceBand = destinationBand;
+		}
+	}
+}
+
+//Applies the rules to rows firstRow to lastRow - 1 of sourceBand, which holds generation sourceGeneration starting at
+//row firstGridRow of the grid, and writes them one after another to destinationRows
+//The source band is never modified, since the rows around each band are needed by the rows next to them
+void GridStream::calculateRows(const int *sourceBand, int firstGridRow, int sourceGeneration, int firstRow, int lastRow,
+	int *destinationRows)
+{
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+#pragma omp parallel for num_threads(N_THREADS) schedule(guided) private(nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish)
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		const int *source = sourceBand + static_cast<size_t>(row) * (cols + 2);
+		int *destination = destinationRows + static_cast<size_t>(row - firstRow) * (cols + 2);
+		int gridRow = ((firstGridRow + row) % rows + rows) % rows;
+		for (int col = 1; col < cols + 1; ++col)
+		{
+			//Get the neighbours' counts
+			getNeighbourCount(sourceBand, row, col, nSharkNeighbours, nFishNeighbours);
+			nBreedingFish = nFishNeighbours % 10;
+			nBreedingSharks = nSharkNeighbours % 10;
+			nFishNeighbours /= 10;
+			nSharkNeighbours /= 10;
+
+			if (source[col] == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					destination[col] = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					destination[col] = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					destination[col] = 0;
+			}
+			else if (source[col] > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					destination[col] = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					destination[col] = 0;
+				else if (source[col] == 10)	//max age reached; fish dies
+					destination[col] = 0;
+				else	//nothing happens to the fish
+					destination[col] = source[col] + 1;	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					destination[col] = 0;
+				else if (isRandomSharkDeath(sourceGeneration, gridRow, col))	//random causes; shark dies. bad luck.
+					destination[col] = 0;
+				else if (source[col] == -20)	//reached max age; shark dies
+					destination[col] = 0;
+				else	//nothing happens, shark survives; increment age
+					destination[col] = source[col] - 1;
+			}
+		}
+	}
+}
+
+//Same as Grid::getNeighbourCount, but for a cell in a band, where the rows are cols + 2 cells apart
+void GridStream::getNeighbourCount(const int *band, int row, int col, int &outSharkCount, int &outFishCount)
+{
+	outFishCount = 0;
+	outSharkCount = 0;
+	int breedingFishCount = 0, breedingSharkCount = 0;
+
+	int currentValue;
+	//check cells around the [row][col] cell (excluding the cell itself)
+	for (int iRow = row - 1; iRow <= row + 1; ++iRow)
+	{
+		for (int iCol = col - 1; iCol <= col + 1; ++iCol)
+		{
+			if (iRow == row && iCol == col)
+				continue;
+
+			currentValue = band[static_cast<size_t>(iRow) * (cols + 2) + iCol];
+			if (currentValue > 0)	//fish
+			{
+				++outFishCount;
+				if (currentValue >= 2)	//breeding age
+					++breedingFishCount;
+			}
+			else if (currentValue < 0)	//shark
+			{
+				++outSharkCount;
+				if (currentValue <= -3)	//breeding age
+					++breedingSharkCount;
+			}
+		}
+	}
+
+	outFishCount = (outFishCount * 10) + breedingFishCount;
+	outSharkCount = (outSharkCount * 10) + breedingSharkCount;
+}
+
+//Decides whether the shark in a cell dies of random causes on the way from the given generation to the next, with the
+//same 1 in 32 odds as the other grids
+//It's worked out from the seed, the generation and the cell's position alone, instead of drawn from Utils, so every
+//band that calculates a row (and every thread) gets the same answer for it.
+bool GridStream::isRandomSharkDeath(int generation, int row, int col)
+{
+	//splitmix64, over the seed, the generation and the position
+	unsigned long long hash = seed + ((static_cast<unsigned long long>(generation) << 32 ^
+		static_cast<unsigned long long>(row)) << 20 ^ static_cast<unsigned long long>(col)) * 0x9E3779B97F4A7C15ULL;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	hash ^= hash >> 31;
+
+	return (hash >> 59) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include<fstream>
+#include<future>
+#include<string>
+#include<vector>
+
+/*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
+These are represented by integers:
+> 0 = fish
+< 0 = shark
+==0 = water
+For sharks and fish, the absolute value of the integer corresponds to their age.
+eg- A cell with value -5 contains a 5-year-old shark.
+
+For grids too big to fit in memory. The grid is kept in a file on disk (one int per cell, row by row, without the
+ghost cells) and is streamed through memory in bands of rows; each generation is written to a second file, and the
+two files then swap places. The grid is left in the file it was given in once the GridStream is destroyed, and a
+later run of the same size can start from it (see the constructor). While one band is being calculated, an I/O thread
+writes out the previous band and reads in the next one. Several generations can be calculated per pass over the file,
+which cuts the disk traffic by the same factor, at the cost of recalculating a few rows at the edges of every band.
+The sharks' random deaths are worked out from each cell's position and generation rather than drawn in turn, so the
+bands agree on the rows they both calculate, and a fused pass gives the same grid as that many single passes.*/
+class GridStream
+{
+public:
+	GridStream(int rows, int cols, std::string filePath, int fusedGenerations = 1, bool loadExistingFile = false);
+	~GridStream();
+	void printStatsToConsole();
+	float runTest(int nIterations);
+	void calculateNextGridState();
+
+protected:
+	//rows and cols don't include ghost cells here, since the file doesn't have any
+	int rows, cols;
+	int fusedGenerations;
+	//Number of rows the grid is read and written in at a time
+	int bandRows;
+	//The file the grid is given in and left in at the end; while it runs, it's in whichever of the two files is current
+	std::string filePath;
+	std::string currentFilePath, nextFilePath;
+	//The seed the sharks' random deaths are worked out from, and the number of generations calculated so far
+	unsigned long long seed;
+	int generation;
+	std::fstream currentFile, nextFile;
+	bool filesOpen;
+
+	//Bands of rows as they are read from and written to the files, two of each so the I/O thread can work on one
+	//while the other is being calculated. The input bands have fusedGenerations extra rows above and below,
+	//and every row in memory has a ghost cell at each end.
+	std::vector<int> inputBands[2], outputBands[2];
+	//Scratch space for the intermediate generations of a fused pass
+	std::vector<int> workBands[2];
+
+	void openFiles(bool loadExistingFile);
+	void initFile(int sharkPercent, int fishPercent);
+	void runPass(int nGenerations);
+	bool readRows(int firstRow, int nRows, int *destination);
+	bool writeRows(int firstRow, int nRows, const int *source);
+	void calculateBand(int *inputBand, int firstGridRow, int nBandRows, int nGenerations, int *outputBand);
+	void calculateRows(const int *sourceBand, int firstGridRow, int sourceGeneration, int firstRow, int lastRow,
+		int *destinationRows);
+	bool isRandomSharkDeath(int generation, int row, int col);
+	void getNeighbourCount(const int *band, int row, int col, int &outSharkCount, int &outFishCount);
+};
\ No newline at end of file
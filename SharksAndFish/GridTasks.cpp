@@ -0,0 +1,277 @@
+#include"stdafx.h"
+#include"GridTasks.h"
+#include"Utils.h"
+
+#include<algorithm>
+#include<ctime>
+#include<thread>
+#include<utility>
+#include<omp.h>
+
+#define N_THREADS 12
+//Size of a tile in cells; the tiles in the last tile row / column take whatever is left over
+#define TILE_ROWS 64
+#define TILE_COLS 256
+
+//Instantiates a grid with the given number of rows and columns, and splits it into tiles
+GridTasks::GridTasks(int rows, int cols) : Grid(rows, cols)
+{
+	nThreads = N_THREADS;
+	nTileRows = (rows + TILE_ROWS - 1) / TILE_ROWS;
+	nTileCols = (cols + TILE_COLS - 1) / TILE_COLS;
+
+	//Find the neighbours of every tile, wrapping around the edges like the ghost cells do
+	//For small grids the same tile can show up more than once, so duplicates are skipped
+	tileNeighbours.resize(nTileRows * nTileCols);
+	for (int tileRow = 0; tileRow < nTileRows; ++tileRow)
+	{
+		for (int tileCol = 0; tileCol < nTileCols; ++tileCol)
+		{
+			std::vector<int> &neighbours = tileNeighbours[tileRow * nTileCols + tileCol];
+			for (int iRow = tileRow - 1; iRow <= tileRow + 1; ++iRow)
+			{
+				for (int iCol = tileCol - 1; iCol <= tileCol + 1; ++iCol)
+				{
+					int neighbour = ((iRow + nTileRows) % nTileRows) * nTileCols + (iCol + nTileCols) % nTileCols;
+					bool isDuplicate = false;
+					for (int existing : neighbours)
+						isDuplicate = isDuplicate || existing == neighbour;
+					if (!isDuplicate)
+						neighbours.push_back(neighbour);
+				}
+			}
+		}
+	}
+}
+
+//Evaluates the rules of the celluar automata and puts values in the nextCalculatedGrid based on them
+void GridTasks::calculateNextGridState()
+{
+	runGenerations(1);
+}
+
+//Runs the grid according to the rules for nIterations, and returns the time it took to complete
+float GridTasks::runTest(int nIterations)
+{
+	float startTime = clock();
+	runGenerations(nIterations);
+	//Generations alternate between the two grids, so after an odd number of them the latest one is in nextCalculatedGrid
+	if (nIterations % 2 == 1)
+		std::swap(currentGrid, nextCalculatedGrid);
+	return clock() - startTime;
+}
+
+//Sets the number of threads the tasks are run on (N_THREADS by default), eg- to compare the grid with GridOMP on the
+//same number of threads
+void GridTasks::setThreadCount(int nThreads)
+{
+	this->nThreads = nThreads > 0 ? nThreads : 1;
+}
+
+int GridTasks::getThreadCount()
+{
+	return nThreads;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Calculates nGenerations generations starting from the currentGrid
+//Generation g is read from grids[(g - 1) % 2] and written to grids[g % 2], where grids[0] is the currentGrid
+//and grids[1] is the nextCalculatedGrid. There is no barrier between generations; a tile is queued as soon as the
+//last of the tiles it depends on has finished the previous generation.
+void GridTasks::runGenerations(int nGenerations)
+{
+	if (nGenerations <= 0)
+		return;
+
+	updateGhostCells();
+
+	int **grids[2] = { currentGrid, nextCalculatedGrid };
+	int nTiles = nTileRows * nTileCols;
+
+	//Number of dependencies each tile is still waiting on, for the next two generations (indexed by generation % 2)
+	//Two counters are enough: a tile's neighbours cannot finish generation g + 2 before the tile finishes g + 1,
+	//so the counter for g + 1 can be reset and reused for g + 3 as soon as it reaches zero
+	std::atomic<int> *pendingDependencies = new std::atomic<int>[2 * nTiles];
+	for (int tile = 0; tile < nTiles; ++tile)
+	{
+		pendingDependencies[2 * tile] = static_cast<int>(tileNeighbours[tile].size());
+		pendingDependencies[2 * tile + 1] = static_cast<int>(tileNeighbours[tile].size());
+	}
+	std::atomic<int> remainingTasks(nTiles * nGenerations);
+
+	//Every tile of the first generation is ready; hand them out in contiguous blocks so each thread starts on its own region
+	std::vector<TaskDeque> deques(nThreads);
+	for (int tile = 0; tile < nTiles; ++tile)
+		deques[static_cast<long long>(tile) * nThreads / nTiles].tasks.push_back({ 1, tile });
+
+#pragma omp parallel num_threads(nThreads)
+	{
+		//The runtime may give us fewer threads than asked for; their deques are then emptied by stealing
+		int thread = omp_get_thread_num();
+		Task task;
+
+		while (remainingTasks > 0)
+		{
+			//Look for work in our own deque first, then try the others
+			bool foundTask = popTask(deques[thread], task);
+			for (int i = 1; i < nThreads && !foundTask; ++i)
+				foundTask = stealTask(deques[(thread + i) % nThreads], task);
+			if (!foundTask)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			int **destinationGrid = grids[task.generation % 2];
+			calculateTile(task.tile, grids[(task.generation - 1) % 2], destinationGrid);
+			updateTileGhostCells(task.tile, destinationGrid);
+
+			//Release the neighbours' next generation; whoever drops a counter to zero queues that tile on its own deque
+			if (task.generation < nGenerations)
+			{
+				int nextParity = (task.generation + 1) % 2;
+				for (int neighbour : tileNeighbours[task.tile])
+				{
+					std::atomic<int> &pending = pendingDependencies[2 * neighbour + nextParity];
+					if (pending.fetch_sub(1) == 1)
+					{
+						pending = static_cast<int>(tileNeighbours[neighbour].size());
+						pushTask(deques[thread], { task.generation + 1, neighbour });
+					}
+				}
+			}
+			--remainingTasks;
+		}
+	}
+
+	delete[] pendingDependencies;
+}
+
+//Applies the rules to one tile, reading from sourceGrid and writing to destinationGrid
+//Unlike the other engines, the source grid is never modified, since other tiles may still be reading from it
+void GridTasks::calculateTile(int tile, int **sourceGrid, int **destinationGrid)
+{
+	int firstRow = 1 + (tile / nTileCols) * TILE_ROWS;
+	int firstCol = 1 + (tile % nTileCols) * TILE_COLS;
+	int lastRow = std::min(firstRow + TILE_ROWS, rows - 1);
+	int lastCol = std::min(firstCol + TILE_COLS, cols - 1);
+
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		for (int col = firstCol; col < lastCol; ++col)
+		{
+			//Get the neighbours' counts
+			getNeighbourCount(sourceGrid, row, col, nSharkNeighbours, nFishNeighbours);
+			nBreedingFish = nFishNeighbours % 10;
+			nBreedingSharks = nSharkNeighbours % 10;
+			nFishNeighbours /= 10;
+			nSharkNeighbours /= 10;
+
+			if (sourceGrid[row][col] == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					destinationGrid[row][col] = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					destinationGrid[row][col] = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					destinationGrid[row][col] = 0;
+			}
+			else if (sourceGrid[row][col] > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					destinationGrid[row][col] = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					destinationGrid[row][col] = 0;
+				else if (sourceGrid[row][col] == 10)	//max age reached; fish dies
+					destinationGrid[row][col] = 0;
+				else	//nothing happens to the fish
+					destinationGrid[row][col] = sourceGrid[row][col] + 1;	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					destinationGrid[row][col] = 0;
+				else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
+					destinationGrid[row][col] = 0;
+				else if (sourceGrid[row][col] == -20)	//reached max age; shark dies
+					destinationGrid[row][col] = 0;
+				else	//nothing happens, shark survives; increment age
+					destinationGrid[row][col] = sourceGrid[row][col] - 1;
+			}
+		}
+	}
+}
+
+//Copies the parts of a tile that lie on the edge of the grid into the ghost cells on the opposite side
+//Only the tiles wrapping around to this one read those ghost cells, and they are all among its dependants
+void GridTasks::updateTileGhostCells(int tile, int **grid)
+{
+	int firstRow = 1 + (tile / nTileCols) * TILE_ROWS;
+	int firstCol = 1 + (tile % nTileCols) * TILE_COLS;
+	int lastRow = std::min(firstRow + TILE_ROWS, rows - 1);
+	int lastCol = std::min(firstCol + TILE_COLS, cols - 1);
+
+	bool touchesTop = firstRow == 1, touchesBottom = lastRow == rows - 1;
+	bool touchesLeft = firstCol == 1, touchesRight = lastCol == cols - 1;
+
+	//rows
+	for (int col = firstCol; col < lastCol; ++col)
+	{
+		if (touchesTop)
+			grid[rows - 1][col] = grid[1][col];	//bottom ghost row = actual top row
+		if (touchesBottom)
+			grid[0][col] = grid[rows - 2][col];	//top ghost row = actual bottom row
+	}
+
+	//columns
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		if (touchesLeft)
+			grid[row][cols - 1] = grid[row][1];	//right ghost column = actual left column
+		if (touchesRight)
+			grid[row][0] = grid[row][cols - 2];	//left ghost column = actual right column
+	}
+
+	//corners
+	if (touchesTop && touchesLeft)
+		grid[rows - 1][cols - 1] = grid[1][1];	//bottom-right ghost = actual top-left
+	if (touchesTop && touchesRight)
+		grid[rows - 1][0] = grid[1][cols - 2];	//bottom-left ghost = actual top-right
+	if (touchesBottom && touchesLeft)
+		grid[0][cols - 1] = grid[rows - 2][1];	//top-right ghost = actual bottom-left
+	if (touchesBottom && touchesRight)
+		grid[0][0] = grid[rows - 2][cols - 2];	//top-left ghost = actual bottom-right
+}
+
+//Adds a task to the back of a deque
+void GridTasks::pushTask(TaskDeque &deque, Task task)
+{
+	std::lock_guard<std::mutex> guard(deque.lock);
+	deque.tasks.push_back(task);
+}
+
+//Takes the most recently added task from a thread's own deque; returns false if it is empty
+//Working on the newest task first keeps a thread on the tiles it has just touched, which are still in its cache
+bool GridTasks::popTask(TaskDeque &deque, Task &outTask)
+{
+	std::lock_guard<std::mutex> guard(deque.lock);
+	if (deque.tasks.empty())
+		return false;
+	outTask = deque.tasks.back();
+	deque.tasks.pop_back();
+	return true;
+}
+
+//Takes the oldest task from another thread's deque; returns false if it is empty
+bool GridTasks::stealTask(TaskDeque &deque, Task &outTask)
+{
+	std::lock_guard<std::mutex> guard(deque.lock);
+	if (deque.tasks.empty())
+		return false;
+	outTask = deque.tasks.front();
+	deque.tasks.pop_front();
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include"Grid.h"
+
+#include<atomic>
+#include<deque>
+#include<mutex>
+#include<vector>
+
+/*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
+These are represented by integers:
+> 0 = fish
+< 0 = shark
+==0 = water
+For sharks and fish, the absolute value of the integer corresponds to their age.
+eg- A cell with value -5 contains a 5-year-old shark.
+
+The grid is split into rectangular tiles, and each (generation, tile) pair is a task. A task becomes runnable as soon
+as the same tile and its 8 neighbouring tiles (wrapping around the edges) have finished the previous generation, so
+threads can run ahead into later generations without waiting for the whole grid. Every thread has its own deque of
+runnable tasks and steals from the other threads' deques when it runs out.*/
+class GridTasks : public Grid
+{
+public:
+	GridTasks(int rows, int cols);
+	void calculateNextGridState();
+	float runTest(int nIterations);
+	void setThreadCount(int nThreads);
+	int getThreadCount();
+
+protected:
+	//A tile of a given generation that is ready to be calculated
+	struct Task
+	{
+		int generation;
+		int tile;
+	};
+
+	//A deque of runnable tasks belonging to one thread
+	//The owner pushes and pops at the back, other threads steal from the front
+	struct TaskDeque
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	//The number of threads the tasks are run on, each with its own deque
+	int nThreads;
+	int nTileRows, nTileCols;
+	//The tiles that each tile depends on (itself and its neighbours, without duplicates)
+	std::vector<std::vector<int>> tileNeighbours;
+
+	void runGenerations(int nGenerations);
+	void calculateTile(int tile, int **sourceGrid, int **destinationGrid);
+	void updateTileGhostCells(int tile, int **grid);
+	void pushTask(TaskDeque &deque, Task task);
+	bool popTask(TaskDeque &deque, Task &outTask);
+	bool stealTask(TaskDeque &deque, Task &outTask);
+};
\ No newline at end of file
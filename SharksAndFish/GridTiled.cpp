@@ -0,0 +1,427 @@
+#include"stdafx.h"
+#include"GridTiled.h"
+#include"Grid.h"
+#include"GridArena.h"
+#include"Utils.h"
+
+#include<algorithm>
+#include<cstring>
+#include<ctime>
+#include<iostream>
+#include<numeric>
+#include<utility>
+#include<vector>
+#include<omp.h>
+#include<opencv2\opencv.hpp>
+
+#define N_THREADS 12
+
+static unsigned long long getMortonCode(unsigned int tileRow, unsigned int tileCol);
+
+//Instantiates a grid with the given number of rows and columns
+GridTiled::GridTiled(int rows, int cols)
+{
+	this->rows = rows;
+	this->cols = cols;
+	nThreads = N_THREADS;
+	tilesDown = (rows + tileSize - 1) / tileSize;
+	tilesAcross = (cols + tileSize - 1) / tileSize;
+
+	//Each of the arena's rows is a whole tile, apron included, starting on a cache line of its own
+	int nTiles = tilesDown * tilesAcross;
+	arena = new GridArena(2, nTiles, tileStride * tileStride);
+	currentTiles = arena->getGrid(0);
+	nextCalculatedTiles = arena->getGrid(1);
+	for (int slot = 0; slot < nTiles; ++slot)
+	{
+		memset(currentTiles[slot], 0, tileStride * tileStride * sizeof(int));
+		memset(nextCalculatedTiles[slot], 0, tileStride * tileStride * sizeof(int));
+	}
+
+	tileSlots = new int[nTiles];
+	slotTileRows = new int[nTiles];
+	slotTileCols = new int[nTiles];
+	layOutTiles();
+
+	//Fill the grid with values
+	initGrid(25, 50);
+}
+
+GridTiled::~GridTiled()
+{
+	delete arena;
+	delete[] tileSlots;
+	delete[] slotTileRows;
+	delete[] slotTileCols;
+}
+
+//Returns the cell at the given row and column (counting from 0)
+int GridTiled::getCell(int row, int col)
+{
+	const int *tile = getTile(currentTiles, row / tileSize, col / tileSize);
+	return tile[(row % tileSize + 1) * tileStride + col % tileSize + 1];
+}
+
+//Sets the cell at the given row and column (counting from 0)
+void GridTiled::setCell(int row, int col, int value)
+{
+	int *tile = getTile(currentTiles, row / tileSize, col / tileSize);
+	tile[(row % tileSize + 1) * tileStride + col % tileSize + 1] = value;
+}
+
+//Sets the number of threads the tiles are calculated on (N_THREADS by default), eg- to compare the grid with GridOMP
+//on the same number of threads
+void GridTiled::setThreadCount(int nThreads)
+{
+	this->nThreads = nThreads > 0 ? nThreads : 1;
+}
+
+int GridTiled::getThreadCount()
+{
+	return nThreads;
+}
+
+//Copies the grid into grid, which is laid out like Grid's currentGrid: (rows + 2) x (cols + 2) cells, with the ghost
+//cells left alone
+void GridTiled::copyToRowMajor(int **grid)
+{
+#pragma omp parallel for num_threads(nThreads)
+	for (int tileRow = 0; tileRow < tilesDown; ++tileRow)
+	{
+		for (int tileCol = 0; tileCol < tilesAcross; ++tileCol)
+		{
+			const int *tile = getTile(currentTiles, tileRow, tileCol);
+			for (int row = 1; row <= getTileRows(tileRow); ++row)
+				memcpy(grid[tileRow * tileSize + row] + tileCol * tileSize + 1, tile + row * tileStride + 1,
+					getTileCols(tileCol) * sizeof(int));
+		}
+	}
+}
+
+//Replaces the grid with the one in grid, which is laid out like Grid's currentGrid (see copyToRowMajor)
+void GridTiled::copyFromRowMajor(int **grid)
+{
+#pragma omp parallel for num_threads(nThreads)
+	for (int tileRow = 0; tileRow < tilesDown; ++tileRow)
+	{
+		for (int tileCol = 0; tileCol < tilesAcross; ++tileCol)
+		{
+			int *tile = getTile(currentTiles, tileRow, tileCol);
+			for (int row = 1; row <= getTileRows(tileRow); ++row)
+				memcpy(tile + row * tileStride + 1, grid[tileRow * tileSize + row] + tileCol * tileSize + 1,
+					getTileCols(tileCol) * sizeof(int));
+		}
+	}
+}
+
+//Prints the contents of the current grid to the console in the form of characters
+void GridTiled::printToConsole(char shark, char fish, char water)
+{
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int cell = getCell(row, col);
+			if (cell > 0)
+				std::cout << fish;
+			else if (cell < 0)
+				std::cout << shark;
+			else
+				std::cout << water;
+		}
+		std::cout << std::endl;
+	}
+}
+
+//Prints the grid's stats, such as the count of shark and fish
+void GridTiled::printStatsToConsole()
+{
+	long long sharkCount = 0, fishCount = 0, waterCount = 0;
+
+	//The order the cells are counted in doesn't matter, so go through the tiles as they are in memory
+	for (int slot = 0; slot < tilesDown * tilesAcross; ++slot)
+	{
+		const int *tile = currentTiles[slot];
+		for (int row = 1; row <= getTileRows(slotTileRows[slot]); ++row)
+		{
+			for (int col = 1; col <= getTileCols(slotTileCols[slot]); ++col)
+			{
+				if (tile[row * tileStride + col] > 0)
+					++fishCount;
+				else if (tile[row * tileStride + col] < 0)
+					++sharkCount;
+				else
+					++waterCount;
+			}
+		}
+	}
+
+	std::cout << "Number of sharks: " << sharkCount << "\nNumber of fish: " << fishCount;
+	std::cout << "\nNumber of water cells: " << waterCount << std::endl;
+}
+
+float GridTiled::runTest(int nIterations)
+{
+	float startTime = clock();
+	for (int i = 0; i < nIterations; ++i)
+	{
+		calculateNextGridState();
+		goToNextGridState();
+	}
+	return clock() - startTime;
+}
+
+//Evaluates the rules of the celluar automata and puts values in the nextCalculatedTiles based on them
+void GridTiled::calculateNextGridState()
+{
+	updateAprons();
+
+	//Neighbouring threads get neighbouring runs of the Z-order, which are compact blocks of the grid
+#pragma omp parallel for num_threads(nThreads) schedule(static)
+	for (int slot = 0; slot < tilesDown * tilesAcross; ++slot)
+		calculateTile(slot);
+}
+
+//Makes the nextCalculatedTiles current; the tiles are swapped, not copied
+void GridTiled::goToNextGridState()
+{
+	std::swap(currentTiles, nextCalculatedTiles);
+}
+
+//Shows the grid as an image using OpenCV (displays the image in a new window)
+void GridTiled::showGridAsImage(std::string additionalInfo)
+{
+	using namespace cv;
+
+	Vec3b waterColour = Vec3b(255, 153, 153);	//light blue
+	Vec3b fishColour = Vec3b(102, 0, 204);		//maroon
+	Vec3b sharkColour = Vec3b(51, 255, 255);	//yellow
+
+	//Create the image (pixels will be empty)
+	Mat gridImage = Mat(rows, cols, CV_8UC3);
+
+	//Each tile fills in its own square of the image
+	for (int slot = 0; slot < tilesDown * tilesAcross; ++slot)
+	{
+		const int *tile = currentTiles[slot];
+		int firstRow = slotTileRows[slot] * tileSize, firstCol = slotTileCols[slot] * tileSize;
+		for (int row = 1; row <= getTileRows(slotTileRows[slot]); ++row)
+		{
+			for (int col = 1; col <= getTileCols(slotTileCols[slot]); ++col)
+			{
+				int cell = tile[row * tileStride + col];
+				if (cell > 0)			//fish
+					gridImage.at<Vec3b>(firstRow + row - 1, firstCol + col - 1) = fishColour;
+				else if (cell == 0)		//empty
+					gridImage.at<Vec3b>(firstRow + row - 1, firstCol + col - 1) = waterColour;
+				else					//shark
+					gridImage.at<Vec3b>(firstRow + row - 1, firstCol + col - 1) = sharkColour;
+			}
+		}
+	}
+
+	cv::imshow("Sharks and Fish" + std::string(" ") + additionalInfo, gridImage);
+	cv::waitKey(0);
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Initializes the grid randomly, with the given percentages of sharks and fish
+//The cells are filled row by row, so the same seed gives the same grid as Grid's initGrid
+void GridTiled::initGrid(int sharkPercent, int fishPercent)
+{
+	int sharkUpperLimit = sharkPercent;
+	int fishUpperLimit = sharkPercent + fishPercent;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int temp = Utils::getRandomNumber(1, 100);
+			if (temp <= sharkUpperLimit)
+				setCell(row, col, -1);	//shark
+			else if (temp <= fishUpperLimit)
+				setCell(row, col, 1);	//fish
+			else
+				setCell(row, col, 0);	//water
+		}
+	}
+}
+
+//Puts the tiles in Z-order: sorted by the Morton codes of their tile rows and columns
+void GridTiled::layOutTiles()
+{
+	int nTiles = tilesDown * tilesAcross;
+	std::vector<int> tiles(nTiles);
+	std::iota(tiles.begin(), tiles.end(), 0);
+	std::sort(tiles.begin(), tiles.end(), [this](int first, int second)
+	{
+		return getMortonCode(first / tilesAcross, first % tilesAcross) <
+			getMortonCode(second / tilesAcross, second % tilesAcross);
+	});
+
+	for (int slot = 0; slot < nTiles; ++slot)
+	{
+		tileSlots[tiles[slot]] = slot;
+		slotTileRows[slot] = tiles[slot] / tilesAcross;
+		slotTileCols[slot] = tiles[slot] % tilesAcross;
+	}
+}
+
+//Returns the tile at the given tile row and column, out of tiles (the current or the next calculated tiles)
+int *GridTiled::getTile(int **tiles, int tileRow, int tileCol)
+{
+	return tiles[tileSlots[tileRow * tilesAcross + tileCol]];
+}
+
+//Returns the number of rows of cells actually used in the tiles of the given tile row
+int GridTiled::getTileRows(int tileRow)
+{
+	return std::min(tileSize, rows - tileRow * tileSize);
+}
+
+//Returns the number of columns of cells actually used in the tiles of the given tile column
+int GridTiled::getTileCols(int tileCol)
+{
+	return std::min(tileSize, cols - tileCol * tileSize);
+}
+
+//Fills every tile's apron from the tiles around it, in parallel
+//Only the aprons are written, and only the cells inside the tiles are read, so the tiles don't get in each other's way
+void GridTiled::updateAprons()
+{
+#pragma omp parallel for num_threads(nThreads) schedule(static)
+	for (int slot = 0; slot < tilesDown * tilesAcross; ++slot)
+		updateApron(slot);
+}
+
+//Fills a tile's apron with the edge cells of the 8 tiles around it, wrapping around the edges of the grid the same way
+//Grid's ghost cells do
+void GridTiled::updateApron(int slot)
+{
+	int tileRow = slotTileRows[slot], tileCol = slotTileCols[slot];
+	int nRows = getTileRows(tileRow), nCols = getTileCols(tileCol);
+	int *tile = currentTiles[slot];
+
+	int tileRowAbove = (tileRow + tilesDown - 1) % tilesDown, tileRowBelow = (tileRow + 1) % tilesDown;
+	int tileColLeft = (tileCol + tilesAcross - 1) % tilesAcross, tileColRight = (tileCol + 1) % tilesAcross;
+	//The last used row of the tiles above and column of the tiles to the left, which may be partly used
+	int lastRowAbove = getTileRows(tileRowAbove), lastColLeft = getTileCols(tileColLeft);
+
+	//rows
+	const int *above = getTile(currentTiles, tileRowAbove, tileCol), *below = getTile(currentTiles, tileRowBelow, tileCol);
+	memcpy(tile + 1, above + lastRowAbove * tileStride + 1, nCols * sizeof(int));
+	memcpy(tile + (nRows + 1) * tileStride + 1, below + tileStride + 1, nCols * sizeof(int));
+
+	//columns
+	const int *left = getTile(currentTiles, tileRow, tileColLeft), *right = getTile(currentTiles, tileRow, tileColRight);
+	for (int row = 1; row <= nRows; ++row)
+	{
+		tile[row * tileStride] = left[row * tileStride + lastColLeft];
+		tile[row * tileStride + nCols + 1] = right[row * tileStride + 1];
+	}
+
+	//corners
+	tile[0] = getTile(currentTiles, tileRowAbove, tileColLeft)[lastRowAbove * tileStride + lastColLeft];
+	tile[nCols + 1] = getTile(currentTiles, tileRowAbove, tileColRight)[lastRowAbove * tileStride + 1];
+	tile[(nRows + 1) * tileStride] = getTile(currentTiles, tileRowBelow, tileColLeft)[tileStride + lastColLeft];
+	tile[(nRows + 1) * tileStride + nCols + 1] = getTile(currentTiles, tileRowBelow, tileColRight)[tileStride + 1];
+}
+
+//Calculates the next generation of one tile, whose apron has been filled
+//The neighbours are counted the way Grid::calculateRows counts them: the tile is encoded (see Grid::encodeCell), each
+//column's 3 cells are added up once per row, and a cell's neighbourhood is the sum of 3 column sums minus the cell
+//itself. The tile is small enough for its encoded cells to stay in the L1 cache the whole time.
+//As in calculateRows, the cells that survive are aged in place in the current tile, so the cells of the row above and
+//the one to the left are seen as they are after that. The apron is filled before any tile is calculated, though, so
+//the cells of the tiles around are seen as they were.
+void GridTiled::calculateTile(int slot)
+{
+	int *current = currentTiles[slot];
+	int *next = nextCalculatedTiles[slot];
+	int nRows = getTileRows(slotTileRows[slot]), nCols = getTileCols(slotTileCols[slot]);
+
+	unsigned short encoded[tileStride * tileStride], columnSums[tileStride];
+	for (int row = 0; row <= nRows + 1; ++row)
+	{
+		for (int col = 0; col <= nCols + 1; ++col)
+			encoded[row * tileStride + col] = Grid::encodeCell(current[row * tileStride + col]);
+	}
+
+	int nSharkNeighbours, nFishNeighbours, nBreedingSharks, nBreedingFish;
+	for (int row = 1; row <= nRows; ++row)
+	{
+		//The row above has already been updated in place (apart from the apron), while this one and the one below
+		//haven't yet
+		unsigned short *encodedRow = encoded + row * tileStride;
+		for (int col = 0; col <= nCols + 1; ++col)
+			columnSums[col] = encodedRow[col - tileStride] + encodedRow[col] + encodedRow[col + tileStride];
+
+		//The cell on the left, as it was and as it is now
+		unsigned short encodedLeft = encodedRow[0], encodedUpdatedLeft = encodedRow[0];
+		for (int col = 1; col <= nCols; ++col)
+		{
+			//Get the neighbours' counts; the cell on the left is swapped for its updated value
+			unsigned int neighbours = columnSums[col - 1] + columnSums[col] + columnSums[col + 1] - encodedRow[col]
+				- encodedLeft + encodedUpdatedLeft;
+			nFishNeighbours = neighbours & 0xF;
+			nBreedingFish = (neighbours >> 4) & 0xF;
+			nSharkNeighbours = (neighbours >> 8) & 0xF;
+			nBreedingSharks = neighbours >> 12;
+
+			int cell = current[row * tileStride + col];
+			int nextCell;
+			if (cell == 0)	//cell is empty
+			{
+				//Breeding Rule
+				if (nFishNeighbours >= 4 && nBreedingFish >= 3 && nSharkNeighbours < 4)	//fish can breed
+					nextCell = 1;	//spawn fish
+				else if (nSharkNeighbours >= 4 && nBreedingSharks >= 3 && nFishNeighbours < 4)	//shark can spawn
+					nextCell = -1;	//spawn shark
+				else	//nothing happens; cell stays empty
+					nextCell = 0;
+			}
+			else if (cell > 0)	//cell has a fish
+			{
+				if (nSharkNeighbours >= 5)	//shark food; fish gets eaten
+					nextCell = 0;
+				else if (nFishNeighbours == 8)	//overpopulation; fish dies
+					nextCell = 0;
+				else if (cell == 10)	//max age reached; fish dies
+					nextCell = 0;
+				else	//nothing happens to the fish
+					nextCell = cell + 1;	//increment fish's age
+			}
+			else	//cell has a shark
+			{
+				if (nSharkNeighbours >= 6 && nFishNeighbours == 0)	//starvation; shark dies
+					nextCell = 0;
+				else if (Utils::getRandomNumber(1, 32) == 1)	//random causes; shark dies. bad luck.
+					nextCell = 0;
+				else if (cell == -20)	//reached max age; shark dies
+					nextCell = 0;
+				else	//nothing happens, shark survives; increment age
+					nextCell = cell - 1;
+			}
+			next[row * tileStride + col] = nextCell;
+
+			//Age the cell in place if it survived, for the cells after it to see
+			if (cell != 0 && nextCell != 0)
+				current[row * tileStride + col] = nextCell;
+			encodedLeft = encodedRow[col];
+			encodedUpdatedLeft = encodedRow[col] = Grid::encodeCell(current[row * tileStride + col]);
+		}
+	}
+}
+
+//Interleaves the bits of a tile's row and column (row bits in the odd places), which orders the tiles along a Z curve
+static unsigned long long getMortonCode(unsigned int tileRow, unsigned int tileCol)
+{
+	unsigned long long code = 0;
+	for (int bit = 0; bit < 32; ++bit)
+	{
+		code |= static_cast<unsigned long long>((tileCol >> bit) & 1) << (2 * bit);
+		code |= static_cast<unsigned long long>((tileRow >> bit) & 1) << (2 * bit + 1);
+	}
+	return code;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include<string>
+
+class GridArena;
+
+/*Represents a 2D grid made up of cells, each being able to contain a shark, a fish, or water.
+These are represented by integers:
+> 0 = fish
+< 0 = shark
+==0 = water
+For sharks and fish, the absolute value of the integer corresponds to their age.
+eg- A cell with value -5 contains a 5-year-old shark.
+
+Instead of one row after another, the cells are kept in square tiles of tileSize x tileSize, each stored in one
+piece, so a cell's 8 neighbours are at most 2 short rows away in memory instead of 2 whole grid rows. Every tile has a
+ring of ghost cells of its own (its apron), which is filled from the neighbouring tiles before each generation, so a
+tile can be calculated without looking at any other tile. The tiles are laid out in Z-order (the order of their Morton
+codes), which keeps tiles that are close together on the grid close together in memory as well. The tiles at the
+right and bottom edges are only partly used when the grid isn't a whole number of tiles.
+
+The rules are applied in the same order as Grid's within each tile: the cells that survive are aged in place, so the
+cells above and to the left of a cell in the same tile are seen as they are after this generation. Across the edges
+of the tiles the cells are seen as they were, and the sharks' random deaths are drawn tile by tile, so the grid only
+follows the same generations as Grid's when it is a single tile.
+
+The grid is only put back in rows for output: see copyToRowMajor, and the printing and image functions.*/
+class GridTiled
+{
+public:
+	//The number of rows and columns of cells in a tile, not counting its apron
+	static constexpr int tileSize = 32;
+
+	GridTiled(int rows, int cols);
+	~GridTiled();
+	int getCell(int row, int col);
+	void setCell(int row, int col, int value);
+	void copyToRowMajor(int **grid);
+	void copyFromRowMajor(int **grid);
+	void printToConsole(char shark = 'X', char fish = 'F', char water = ' ');
+	void printStatsToConsole();
+	float runTest(int nIterations);
+	void calculateNextGridState();
+	void goToNextGridState();
+	void showGridAsImage(std::string additionalInfo = "");
+	void setThreadCount(int nThreads);
+	int getThreadCount();
+
+protected:
+	//The number of cells from one row of a tile to the next, including the apron
+	static constexpr int tileStride = tileSize + 2;
+
+	//rows and cols don't include ghost cells here, since every tile has its own
+	int rows, cols;
+	//The number of threads the tiles are shared out between
+	int nThreads;
+	int tilesDown, tilesAcross;
+	//Both grids' tiles, one tile per arena row; the current tiles are the ones in currentTiles
+	GridArena *arena;
+	int **currentTiles, **nextCalculatedTiles;
+	//Where each tile is in the Z-order (tile row by tile row), and which tile is at each place in it
+	int *tileSlots;
+	int *slotTileRows, *slotTileCols;
+
+	void initGrid(int sharkPercent, int fishPercent);
+	void layOutTiles();
+	int *getTile(int **tiles, int tileRow, int tileCol);
+	int getTileRows(int tileRow);
+	int getTileCols(int tileCol);
+	void updateAprons();
+	void updateApron(int slot);
+	void calculateTile(int slot);
+};
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include"stdafx.h"
+#include"HistoryLog.h"
+
+#include<iostream>
+
+#define HISTORY_LOG_VERSION 1
+
+//Opens (and empties) the file the generations are to be recorded to
+//The whole grid is written every keyframeInterval generations, starting with the first one
+HistoryWriter::HistoryWriter(std::string filePath, int keyframeInterval)
+{
+	this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+	rows = 0;
+	cols = 0;
+	nextGeneration = 0;
+
+	file.open(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		std::cout << "Could not open " << filePath << " to record the history to!" << std::endl;
+}
+
+HistoryWriter::~HistoryWriter()
+{
+	file.close();
+}
+
+//Records the next generation; rows and cols include the ghost cells, which are not recorded
+//The first call writes the file's header, so all the generations must come from grids of the same size
+void HistoryWriter::recordGeneration(int **grid, int rows, int cols)
+{
+	if (!file.is_open())
+		return;
+
+	if (nextGeneration == 0)
+	{
+		this->rows = rows - 2;
+		this->cols = cols - 2;
+		previousCells.resize(static_cast<size_t>(this->rows) * this->cols);
+
+		//The magic bytes are pushed one at a time, since GCC 12 warns (wrongly) about inserting them all at once into
+		//the emptied payload
+		static const unsigned char magic[4] = { 'S', 'F', 'H', 'L' };
+		payload.clear();
+		for (unsigned char byte : magic)
+			payload.push_back(byte);
+		HistoryLog::appendVarint(payload, HISTORY_LOG_VERSION);
+		HistoryLog::appendVarint(payload, this->rows);
+		HistoryLog::appendVarint(payload, this->cols);
+		file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	}
+
+	if (nextGeneration % keyframeInterval == 0)
+		writeKeyframe(grid);
+	else
+		writeDelta(grid);
+	++nextGeneration;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Writes the whole grid as runs of cells with the same value
+void HistoryWriter::writeKeyframe(int **grid)
+{
+	payload.clear();
+	int runValue = grid[1][1], runLength = 0;
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int value = grid[row + 1][col + 1];
+			previousCells[static_cast<size_t>(row) * cols + col] = static_cast<signed char>(value);
+			if (value != runValue)
+			{
+				HistoryLog::appendSignedVarint(payload, runValue);
+				HistoryLog::appendVarint(payload, runLength);
+				runValue = value;
+				runLength = 0;
+			}
+			++runLength;
+		}
+	}
+	HistoryLog::appendSignedVarint(payload, runValue);
+	HistoryLog::appendVarint(payload, runLength);
+
+	writeRecord('K');
+}
+
+//Writes the cells that aren't what getAgedValue says they would be, going by the previous generation
+void HistoryWriter::writeDelta(int **grid)
+{
+	//The changes go after their count, which isn't known until the end
+	record.clear();
+	long long nChanges = 0;
+	size_t lastChangeEnd = 0;
+	for (int row = 0; row < rows; ++row)
+	{
+		signed char *previous = previousCells.data() + static_cast<size_t>(row) * cols;
+		for (int col = 0; col < cols; ++col)
+		{
+			int value = grid[row + 1][col + 1];
+			if (value != HistoryLog::getAgedValue(previous[col]))
+			{
+				size_t cell = static_cast<size_t>(row) * cols + col;
+				HistoryLog::appendVarint(record, cell - lastChangeEnd);
+				HistoryLog::appendSignedVarint(record, value);
+				lastChangeEnd = cell + 1;
+				++nChanges;
+			}
+			previous[col] = static_cast<signed char>(value);
+		}
+	}
+
+	payload.clear();
+	HistoryLog::appendVarint(payload, nChanges);
+	payload.insert(payload.end(), record.begin(), record.end());
+
+	writeRecord('D');
+}
+
+//Writes a record of the given type for the next generation, with whatever is in payload
+void HistoryWriter::writeRecord(char type)
+{
+	record.clear();
+	record.push_back(static_cast<unsigned char>(type));
+	HistoryLog::appendVarint(record, nextGeneration);
+	HistoryLog::appendVarint(record, payload.size());
+	file.write(reinterpret_cast<const char*>(record.data()), record.size());
+	file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+}
+
+//Opens a file written by a HistoryWriter and finds where each generation's record is
+//If the file can't be read, it is treated as having no generations
+HistoryReader::HistoryReader(std::string filePath)
+{
+	rows = 0;
+	cols = 0;
+	cellsGeneration = -1;
+
+	file.open(filePath, std::ios::in | std::ios::binary);
+	char magic[4] = {};
+	file.read(magic, 4);
+	unsigned long long version = 0, headerRows = 0, headerCols = 0;
+	if (!file || std::string(magic, 4) != "SFHL" || !HistoryLog::readVarint(file, version) || version != HISTORY_LOG_VERSION
+		|| !HistoryLog::readVarint(file, headerRows) || !HistoryLog::readVarint(file, headerCols))
+	{
+		std::cout << "Could not read the history in " << filePath << "!" << std::endl;
+		return;
+	}
+	rows = static_cast<int>(headerRows);
+	cols = static_cast<int>(headerCols);
+
+	//Skip from one record to the next; a record that was cut short (eg- if the program was stopped while writing it)
+	//is left out along with everything after it
+	std::streamoff headerEnd = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(headerEnd);
+	while (true)
+	{
+		std::streamoff offset = file.tellg();
+		char type;
+		unsigned long long generation, payloadSize;
+		if (!file.get(type) || !HistoryLog::readVarint(file, generation) || !HistoryLog::readVarint(file, payloadSize))
+			break;
+		std::streamoff payloadEnd = file.tellg() + static_cast<std::streamoff>(payloadSize);
+		if (generation != records.size() || payloadEnd > fileSize)
+			break;
+		records.push_back({ offset, type == 'K' });
+		file.seekg(payloadEnd);
+	}
+	file.clear();
+}
+
+int HistoryReader::getRows()
+{
+	return rows;
+}
+
+int HistoryReader::getCols()
+{
+	return cols;
+}
+
+//Returns the number of generations in the file
+int HistoryReader::getGenerationCount()
+{
+	return static_cast<int>(records.size());
+}
+
+//Puts the given generation's cells (row by row, without ghost cells) into outCells
+//Returns false if there is no such generation
+bool HistoryReader::readGeneration(int generation, std::vector<int> &outCells)
+{
+	if (generation < 0 || generation >= getGenerationCount())
+		return false;
+
+	//Start from the closest keyframe at or before the generation, unless the last generation read is closer
+	int keyframe = generation;
+	while (!records[keyframe].isKeyframe)
+		--keyframe;
+	int firstRecord = cellsGeneration >= keyframe && cellsGeneration <= generation ? cellsGeneration + 1 : keyframe;
+
+	for (int record = firstRecord; record <= generation; ++record)
+		readRecord(record);
+
+	outCells = cells;
+	return true;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Reads a generation's record and applies it to cells, which must hold the generation before it unless it's a keyframe
+void HistoryReader::readRecord(int generation)
+{
+	char type;
+	unsigned long long recordGeneration, payloadSize;
+	file.seekg(records[generation].offset);
+	file.get(type);
+	HistoryLog::readVarint(file, recordGeneration);
+	HistoryLog::readVarint(file, payloadSize);
+
+	std::vector<unsigned char> payload(static_cast<size_t>(payloadSize));
+	file.read(reinterpret_cast<char*>(payload.data()), payload.size());
+	const unsigned char *position = payload.data();
+
+	size_t nCells = static_cast<size_t>(rows) * cols;
+	if (type == 'K')
+	{
+		cells.resize(nCells);
+		for (size_t cell = 0; cell < nCells;)
+		{
+			int value = static_cast<int>(HistoryLog::readSignedVarint(position));
+			size_t runLength = static_cast<size_t>(HistoryLog::readVarint(position));
+			if (runLength == 0)
+				break;
+			for (size_t i = 0; i < runLength && cell < nCells; ++i)
+				cells[cell++] = value;
+		}
+	}
+	else
+	{
+		//Every cell that isn't listed just gets older
+		unsigned long long nChanges = HistoryLog::readVarint(position);
+		size_t cell = 0;
+		for (unsigned long long change = 0; change < nChanges; ++change)
+		{
+			size_t changedCell = cell + static_cast<size_t>(HistoryLog::readVarint(position));
+			for (; cell < changedCell && cell < nCells; ++cell)
+				cells[cell] = HistoryLog::getAgedValue(cells[cell]);
+			if (cell < nCells)
+				cells[cell++] = static_cast<int>(HistoryLog::readSignedVarint(position));
+		}
+		for (; cell < nCells; ++cell)
+			cells[cell] = HistoryLog::getAgedValue(cells[cell]);
+	}
+
+	cellsGeneration = generation;
+}
+
+//Returns what a cell would be in the next generation if nothing happened to it other than getting older
+//Fish and sharks still die when they reach their maximum age
+int HistoryLog::getAgedValue(int value)
+{
+	if (value > 0)	//fish
+		return value == 10 ? 0 : value + 1;
+	else if (value < 0)	//shark
+		return value == -20 ? 0 : value - 1;
+	else	//water
+		return 0;
+}
+
+//Appends an unsigned integer to the buffer, 7 bits per byte, with the top bit set on all bytes but the last
+void HistoryLog::appendVarint(std::vector<unsigned char> &buffer, unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<unsigned char>(value));
+}
+
+//Appends a signed integer to the buffer, zigzag encoded (0, -1, 1, -2, ... become 0, 1, 2, 3, ...) so that small
+//negative values stay small
+void HistoryLog::appendSignedVarint(std::vector<unsigned char> &buffer, long long value)
+{
+	appendVarint(buffer, (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63));
+}
+
+//Reads an unsigned integer written by appendVarint from the stream; returns false if the stream ran out first
+bool HistoryLog::readVarint(std::istream &stream, unsigned long long &outValue)
+{
+	outValue = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		char byte;
+		if (!stream.get(byte))
+			return false;
+		outValue |= static_cast<unsigned long long>(static_cast<unsigned char>(byte) & 0x7F) << shift;
+		if ((static_cast<unsigned char>(byte) & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+//Reads an unsigned integer written by appendVarint from memory, and moves position past it
+unsigned long long HistoryLog::readVarint(const unsigned char *&position)
+{
+	unsigned long long value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		unsigned char byte = *position++;
+		value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			break;
+	}
+	return value;
+}
+
+//Reads a signed integer written by appendSignedVarint from memory, and moves position past it
+long long HistoryLog::readSignedVarint(const unsigned char *&position)
+{
+	unsigned long long value = readVarint(position);
+	return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
\ No newline at end of file
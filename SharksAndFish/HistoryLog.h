@@ -0,0 +1,75 @@
+#pragma once
+#include<fstream>
+#include<string>
+#include<vector>
+
+/*Records every generation of a grid to a file, and reads them back.
+Most cells just get one year older from one generation to the next, so for most generations only the cells that
+don't follow that rule are written: births, deaths other than from old age, and so on. Each of these is stored as
+the number of cells skipped since the previous one and the cell's new value, both as variable-length integers, which
+usually takes 2 bytes. Every keyframeInterval generations the whole grid is written instead, run-length encoded, so
+the reader can jump to any generation without going through all the ones before it.
+
+File layout (all integers are variable-length, with signed ones zigzag encoded):
+header:  "SFHL", version, rows, cols
+records: type ('K' = keyframe, 'D' = delta), generation, payload size in bytes, payload
+keyframe payload: (value, run length) pairs covering the grid row by row
+delta payload:    number of changes, then (cells skipped, new value) for each change*/
+class HistoryWriter
+{
+public:
+	HistoryWriter(std::string filePath, int keyframeInterval = 64);
+	~HistoryWriter();
+	void recordGeneration(int **grid, int rows, int cols);
+
+protected:
+	std::ofstream file;
+	int keyframeInterval;
+	int rows, cols;
+	int nextGeneration;
+	//The last generation recorded, one byte per cell (without the ghost cells); ages always fit in a byte
+	std::vector<signed char> previousCells;
+	std::vector<unsigned char> payload, record;
+
+	void writeKeyframe(int **grid);
+	void writeDelta(int **grid);
+	void writeRecord(char type);
+};
+
+class HistoryReader
+{
+public:
+	HistoryReader(std::string filePath);
+	int getRows();
+	int getCols();
+	int getGenerationCount();
+	bool readGeneration(int generation, std::vector<int> &outCells);
+
+protected:
+	//Where a generation's record starts in the file
+	struct RecordInfo
+	{
+		std::streamoff offset;
+		bool isKeyframe;
+	};
+
+	std::ifstream file;
+	int rows, cols;
+	std::vector<RecordInfo> records;
+	//The last generation read, so reading the generations in order only has to apply one delta each time
+	std::vector<int> cells;
+	int cellsGeneration;
+
+	void readRecord(int generation);
+};
+
+//Helpers shared by the writer and the reader
+namespace HistoryLog
+{
+	int getAgedValue(int value);
+	void appendVarint(std::vector<unsigned char> &buffer, unsigned long long value);
+	void appendSignedVarint(std::vector<unsigned char> &buffer, long long value);
+	bool readVarint(std::istream &stream, unsigned long long &outValue);
+	unsigned long long readVarint(const unsigned char *&position);
+	long long readSignedVarint(const unsigned char *&position);
+}
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include"stdafx.h"
+#include"InitialState.h"
+
+#include<algorithm>
+#include<cctype>
+#include<cmath>
+#include<cstdio>
+#include<fstream>
+#include<iostream>
+#include<omp.h>
+
+//The seed cells are rolled with unless setSeed is called; the same as Utils::initUtils' default
+#define DEFAULT_INITIAL_STATE_SEED 16897
+
+static bool readHeaderNumber(std::ifstream &file, int &outNumber);
+
+//Reads the file's header (or the whole file, for patterns); the pixels of a map are only read when they're needed
+//If the file can't be read, the InitialState is left invalid and fill does nothing
+InitialState::InitialState(std::string filePath)
+{
+	this->filePath = filePath;
+	kind = FileKind::None;
+	width = 0;
+	height = 0;
+	scaling = Scaling::Nearest;
+	seed = DEFAULT_INITIAL_STATE_SEED;
+	pixelsOffset = 0;
+	bytesPerSample = 1;
+	maxSample = 255;
+	firstPixelRow = 0;
+	nPixelRows = 0;
+
+	std::ifstream file(filePath, std::ios::in | std::ios::binary);
+	char magic[2] = {};
+	file.read(magic, 2);
+	bool isRead;
+	if (file && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6'))
+	{
+		kind = magic[1] == '5' ? FileKind::GreyMap : FileKind::ColourMap;
+		isRead = readMapHeader(file);
+	}
+	else
+	{
+		kind = FileKind::Pattern;
+		file.clear();
+		file.seekg(0);
+		isRead = file.is_open() && readPattern(file);
+	}
+
+	if (!isRead)
+	{
+		std::cout << "Could not read the initial state in " << filePath << "!" << std::endl;
+		kind = FileKind::None;
+		width = 0;
+		height = 0;
+		return;
+	}
+
+	//Grey levels default to initGrid(25, 50)'s percentages, scaled by the brightness; red and green are percentages
+	for (int level = 0; level < 256; ++level)
+	{
+		sharkPercents[level] = (kind == FileKind::GreyMap ? 25.0f : 100.0f) * level / 255;
+		fishPercents[level] = (kind == FileKind::GreyMap ? 50.0f : 100.0f) * level / 255;
+	}
+}
+
+//Returns whether the file was read
+bool InitialState::isValid()
+{
+	return kind != FileKind::None;
+}
+
+//Returns the width of the map or pattern, in pixels or cells
+int InitialState::getWidth()
+{
+	return width;
+}
+
+//Returns the height of the map or pattern, in pixels or cells
+int InitialState::getHeight()
+{
+	return height;
+}
+
+//Sets the percentages of cells that start with a shark and with a fish in the region of a grey map that has the given
+//grey level (0 to 255, whatever the map's largest value; it's scaled to that); colour maps and patterns ignore this
+void InitialState::setRegion(int level, float sharkPercent, float fishPercent)
+{
+	if (kind != FileKind::GreyMap || level < 0 || level > 255)
+		return;
+	sharkPercents[level] = sharkPercent;
+	fishPercents[level] = fishPercent;
+}
+
+//Sets how maps are scaled to the grid; patterns are never scaled
+void InitialState::setScaling(Scaling scaling)
+{
+	this->scaling = scaling;
+}
+
+//Sets the seed the cells' odds are rolled with; every process has to use the same one to get one consistent grid
+void InitialState::setSeed(unsigned long long seed)
+{
+	this->seed = seed;
+}
+
+//Fills the cells of grid (rows x cols, including the ghost cells, which are left alone) as rows firstRow on of a grid
+//of totalRows rows (0 meaning just this one) that the map is scaled to, or the pattern repeated across
+//Returns false if the map's pixels couldn't be read.
+bool InitialState::fill(int **grid, int rows, int cols, int firstRow, int totalRows)
+{
+	if (totalRows <= 0)
+		totalRows = rows - 2;
+	if (!isValid() || rows < 2 || cols < 3 || firstRow < 0 || firstRow + rows - 2 > totalRows)
+		return false;
+	if (rows == 2)
+		return true;
+
+	if (kind == FileKind::Pattern)
+	{
+		fillFromPattern(grid, rows, cols, firstRow);
+		return true;
+	}
+
+	//Only read the rows of the map that this grid's rows are made from
+	int nRows = rows - 2;
+	int lastRow = firstRow + nRows - 1;
+	int firstNeededRow, lastNeededRow;
+	if (scaling == Scaling::Nearest)
+	{
+		firstNeededRow = static_cast<int>((2LL * firstRow + 1) * height / (2LL * totalRows));
+		lastNeededRow = static_cast<int>((2LL * lastRow + 1) * height / (2LL * totalRows));
+	}
+	else
+	{
+		firstNeededRow = std::max(static_cast<int>(std::floor((firstRow + 0.5) * height / totalRows - 0.5)), 0);
+		lastNeededRow = std::max(static_cast<int>(std::floor((lastRow + 0.5) * height / totalRows - 0.5)), 0);
+		lastNeededRow = std::min(lastNeededRow + 1, height - 1);
+	}
+	if (!readPixelRows(firstNeededRow, lastNeededRow + 1))
+	{
+		std::cout << "Could not read the map in " << filePath << "!" << std::endl;
+		return false;
+	}
+
+	fillFromMap(grid, rows, cols, firstRow, totalRows);
+	return true;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Reads the width, height and largest value of a PGM or PPM map, after its magic number, and checks the file is big
+//enough to hold all the pixels
+bool InitialState::readMapHeader(std::ifstream &file)
+{
+	if (!readHeaderNumber(file, width) || !readHeaderNumber(file, height) || !readHeaderNumber(file, maxSample)
+		|| width <= 0 || height <= 0 || maxSample <= 0 || maxSample > 65535)
+		return false;
+
+	//Exactly one whitespace character comes between the largest value and the pixels
+	file.get();
+	pixelsOffset = static_cast<long long>(file.tellg());
+	bytesPerSample = maxSample > 255 ? 2 : 1;
+
+	file.seekg(0, std::ios::end);
+	long long fileSize = static_cast<long long>(file.tellg());
+	return file && fileSize - pixelsOffset >= static_cast<long long>(width) * height * getChannelCount() * bytesPerSample;
+}
+
+//Reads a whole run-length encoded pattern into pattern (see above); comment lines start with #, and the pattern's size
+//comes first, as "x = width, y = height"
+bool InitialState::readPattern(std::ifstream &file)
+{
+	std::string line, cells;
+	bool hasSize = false;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		if (!hasSize)
+		{
+			std::string size;
+			for (char c : line)
+			{
+				if (!isspace(static_cast<unsigned char>(c)))
+					size += c;
+			}
+			if (sscanf(size.c_str(), "x=%d,y=%d", &width, &height) != 2 || width <= 0 || height <= 0)
+				return false;
+			hasSize = true;
+			continue;
+		}
+		cells += line;
+	}
+	if (!hasSize)
+		return false;
+
+	//Cells that aren't given are water
+	pattern.assign(static_cast<size_t>(width) * height, 0);
+	int row = 0, col = 0, count = 0;
+	for (char tag : cells)
+	{
+		if (isdigit(static_cast<unsigned char>(tag)))
+		{
+			count = std::min(count * 10 + (tag - '0'), 1 << 24);
+			continue;
+		}
+		if (isspace(static_cast<unsigned char>(tag)))
+			continue;
+
+		int nCells = count > 0 ? count : 1;
+		count = 0;
+		int value;
+		if (tag == 'b' || tag == '.')
+			value = 0;
+		else if (tag == 'o' || tag == 'f' || tag == 'A')
+			value = 1;
+		else if (tag == 's' || tag == 'B')
+			value = -1;
+		else if (tag == '$')
+		{
+			row += nCells;
+			col = 0;
+			continue;
+		}
+		else if (tag == '!')
+			break;
+		else
+			return false;
+
+		//Anything past the edges given in the size is dropped
+		for (int i = 0; i < nCells && col < width; ++i, ++col)
+		{
+			if (row < height)
+				pattern[static_cast<size_t>(row) * width + col] = static_cast<signed char>(value);
+		}
+	}
+	return true;
+}
+
+//Makes sure the map's rows firstRow to lastRow (not included) are in pixels, reading them if they aren't, with each
+//thread reading its share of them through its own stream
+bool InitialState::readPixelRows(int firstRow, int lastRow)
+{
+	if (firstRow >= firstPixelRow && lastRow <= firstPixelRow + nPixelRows)
+		return true;
+
+	int channels = getChannelCount();
+	size_t pixelRowSize = static_cast<size_t>(width) * channels;
+	pixels.resize(pixelRowSize * (lastRow - firstRow));
+	firstPixelRow = firstRow;
+	nPixelRows = lastRow - firstRow;
+
+	int nFailed = 0;
+#pragma omp parallel reduction(+:nFailed)
+	{
+		int nThreads = omp_get_num_threads(), thread = omp_get_thread_num();
+		int threadFirstRow = firstRow + static_cast<int>(static_cast<long long>(nPixelRows) * thread / nThreads);
+		int threadLastRow = firstRow + static_cast<int>(static_cast<long long>(nPixelRows) * (thread + 1) / nThreads);
+		size_t nSamples = pixelRowSize * (threadLastRow - threadFirstRow);
+		unsigned char *threadPixels = pixels.data() + pixelRowSize * (threadFirstRow - firstRow);
+
+		std::ifstream file(filePath, std::ios::in | std::ios::binary);
+		file.seekg(pixelsOffset + static_cast<long long>(threadFirstRow) * pixelRowSize * bytesPerSample);
+		if (bytesPerSample == 1)
+		{
+			file.read(reinterpret_cast<char*>(threadPixels), nSamples);
+			if (maxSample != 255)
+			{
+				for (size_t sample = 0; sample < nSamples; ++sample)
+					threadPixels[sample] = static_cast<unsigned char>(std::min(threadPixels[sample] * 255 / maxSample, 255));
+			}
+		}
+		else
+		{
+			//16-bit samples are stored most significant byte first
+			std::vector<unsigned char> wideSamples(nSamples * 2);
+			file.read(reinterpret_cast<char*>(wideSamples.data()), wideSamples.size());
+			for (size_t sample = 0; sample < nSamples; ++sample)
+			{
+				int value = wideSamples[2 * sample] << 8 | wideSamples[2 * sample + 1];
+				threadPixels[sample] = static_cast<unsigned char>(std::min(value * 255 / maxSample, 255));
+			}
+		}
+		if (!file)
+			++nFailed;
+	}
+
+	if (nFailed > 0)
+	{
+		nPixelRows = 0;
+		return false;
+	}
+	return true;
+}
+
+//Fills the grid's cells from the map, whose needed rows have been read (see fill)
+void InitialState::fillFromMap(int **grid, int rows, int cols, int firstRow, int totalRows)
+{
+	//Which pixel columns each grid column is made from, and (for Bilinear) how much of the second one goes into it
+	int nCols = cols - 2;
+	std::vector<int> leftPixels(nCols), rightPixels(nCols);
+	std::vector<float> rightWeights(nCols, 0);
+	for (int col = 0; col < nCols; ++col)
+	{
+		if (scaling == Scaling::Nearest)
+		{
+			leftPixels[col] = rightPixels[col] = static_cast<int>((2LL * col + 1) * width / (2LL * nCols));
+			continue;
+		}
+		double x = (col + 0.5) * width / nCols - 0.5;
+		leftPixels[col] = std::max(static_cast<int>(std::floor(x)), 0);
+		rightPixels[col] = std::min(leftPixels[col] + 1, width - 1);
+		rightWeights[col] = static_cast<float>(std::min(std::max(x - leftPixels[col], 0.0), 1.0));
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		long long gridRow = firstRow + row - 1;
+		int topPixel, bottomPixel;
+		float bottomWeight = 0;
+		if (scaling == Scaling::Nearest)
+			topPixel = bottomPixel = static_cast<int>((2 * gridRow + 1) * height / (2LL * totalRows));
+		else
+		{
+			double y = (gridRow + 0.5) * height / totalRows - 0.5;
+			topPixel = std::max(static_cast<int>(std::floor(y)), 0);
+			bottomPixel = std::min(topPixel + 1, height - 1);
+			bottomWeight = static_cast<float>(std::min(std::max(y - topPixel, 0.0), 1.0));
+		}
+
+		for (int col = 0; col < nCols; ++col)
+		{
+			float sharkPercent, fishPercent;
+			getPercents(topPixel, leftPixels[col], sharkPercent, fishPercent);
+			if (scaling == Scaling::Bilinear)
+			{
+				//Blend the percentages of the 4 pixels around the cell's centre
+				float corners[3][2];
+				getPercents(topPixel, rightPixels[col], corners[0][0], corners[0][1]);
+				getPercents(bottomPixel, leftPixels[col], corners[1][0], corners[1][1]);
+				getPercents(bottomPixel, rightPixels[col], corners[2][0], corners[2][1]);
+				float topShark = sharkPercent + (corners[0][0] - sharkPercent) * rightWeights[col];
+				float topFish = fishPercent + (corners[0][1] - fishPercent) * rightWeights[col];
+				float bottomShark = corners[1][0] + (corners[2][0] - corners[1][0]) * rightWeights[col];
+				float bottomFish = corners[1][1] + (corners[2][1] - corners[1][1]) * rightWeights[col];
+				sharkPercent = topShark + (bottomShark - topShark) * bottomWeight;
+				fishPercent = topFish + (bottomFish - topFish) * bottomWeight;
+			}
+			grid[row][col + 1] = rollCell(sharkPercent, fishPercent, gridRow, col);
+		}
+	}
+}
+
+//Fills the grid's cells with the pattern, repeated across and down from the grid's top-left corner
+void InitialState::fillFromPattern(int **grid, int rows, int cols, int firstRow)
+{
+#pragma omp parallel for schedule(static)
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		const signed char *patternRow = pattern.data() + static_cast<size_t>((firstRow + row - 1) % height) * width;
+		for (int col = 1; col < cols - 1; ++col)
+			grid[row][col] = patternRow[(col - 1) % width];
+	}
+}
+
+//Returns the number of bytes each of the map's pixels takes in pixels
+int InitialState::getChannelCount()
+{
+	return kind == FileKind::ColourMap ? 3 : 1;
+}
+
+//Gets the shark and fish percentages of one of the map's pixels, which must have been read
+void InitialState::getPercents(int pixelRow, int pixelCol, float &outSharkPercent, float &outFishPercent)
+{
+	int channels = getChannelCount();
+	const unsigned char *pixel = pixels.data() + (static_cast<size_t>(pixelRow - firstPixelRow) * width + pixelCol) * channels;
+	outSharkPercent = sharkPercents[pixel[0]];
+	//Colour maps keep the fish in the green (the second byte); grey maps keep both in the one byte
+	outFishPercent = fishPercents[pixel[channels == 3 ? 1 : 0]];
+}
+
+//Decides what a cell starts as, the way initGrid(sharkPercent, fishPercent) does, but with a random number made from
+//the seed and the cell's position in the whole grid
+int InitialState::rollCell(float sharkPercent, float fishPercent, long long row, long long col)
+{
+	//splitmix64, over the seed and the position
+	unsigned long long hash = seed + (static_cast<unsigned long long>(row) << 32 ^ static_cast<unsigned long long>(col)) *
+		0x9E3779B97F4A7C15ULL;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	hash ^= hash >> 31;
+
+	float roll = static_cast<float>((hash >> 40) * (100.0 / (1ULL << 24)));
+	if (roll < sharkPercent)
+		return -1;	//shark
+	else if (roll < sharkPercent + fishPercent)
+		return 1;	//fish
+	else
+		return 0;	//water
+}
+
+//Reads the next number in a PGM or PPM header, skipping whitespace and comments (from # to the end of the line)
+static bool readHeaderNumber(std::ifstream &file, int &outNumber)
+{
+	int next;
+	while ((next = file.peek()) != EOF)
+	{
+		if (next == '#')
+		{
+			std::string comment;
+			std::getline(file, comment);
+		}
+		else if (isspace(next))
+			file.get();
+		else
+			break;
+	}
+	return static_cast<bool>(file >> outNumber);
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include<string>
+#include<vector>
+
+/*A starting grid made from a file, instead of the same odds of a shark or a fish everywhere. The file can be:
+> a binary PGM (P5) map, whose grey levels are regions, each with its own shark and fish percentages (see setRegion);
+  by default they're those of initGrid(25, 50) scaled by the brightness, so black is all water
+> a binary PPM (P6) species map, whose red and green give the shark and fish percentages directly (0 to 255 mapping
+  to 0 to 100%), with blue left out
+> a run-length encoded pattern (the format used for Life patterns, with b or . for water, o, f or A for a fish, s or B
+  for a shark, $ for the end of a row and ! for the end), which is repeated across the grid as it is
+
+Maps are stretched or shrunk to the grid, by taking each cell's nearest pixel or by blending the percentages of the
+4 nearest (see Scaling). Only the rows of a map that a grid's rows need are read, split between all the threads, and
+the cells are filled in parallel too. Each cell's odds are rolled with a random number made from the seed and the
+cell's position alone, so the same file and seed give the same grid however it's split between threads or processes.*/
+class InitialState
+{
+public:
+	enum class Scaling { Nearest, Bilinear };
+
+	InitialState(std::string filePath);
+	bool isValid();
+	int getWidth();
+	int getHeight();
+	void setRegion(int level, float sharkPercent, float fishPercent);
+	void setScaling(Scaling scaling);
+	void setSeed(unsigned long long seed);
+	bool fill(int **grid, int rows, int cols, int firstRow = 0, int totalRows = 0);
+
+protected:
+	enum class FileKind { None, GreyMap, ColourMap, Pattern };
+
+	std::string filePath;
+	FileKind kind;
+	int width, height;
+	Scaling scaling;
+	unsigned long long seed;
+
+	//For maps: where the pixels start in the file, how many bytes each sample takes, and the largest sample value
+	long long pixelsOffset;
+	int bytesPerSample, maxSample;
+	//The shark and fish percentages of each grey level (grey maps) or of each red and green level (colour maps)
+	float sharkPercents[256], fishPercents[256];
+	//The rows of the map read so far, from firstPixelRow on, as 1 (grey) or 3 (colour) bytes per pixel, scaled to 0-255
+	std::vector<unsigned char> pixels;
+	int firstPixelRow, nPixelRows;
+
+	//For patterns: one cell value per cell, row by row
+	std::vector<signed char> pattern;
+
+	bool readMapHeader(std::ifstream &file);
+	bool readPattern(std::ifstream &file);
+	bool readPixelRows(int firstRow, int lastRow);
+	void fillFromMap(int **grid, int rows, int cols, int firstRow, int totalRows);
+	void fillFromPattern(int **grid, int rows, int cols, int firstRow);
+	int getChannelCount();
+	void getPercents(int pixelRow, int pixelCol, float &outSharkPercent, float &outFishPercent);
+	int rollCell(float sharkPercent, float fishPercent, long long row, long long col);
+};
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include"stdafx.h"
+#include"JobRunner.h"
+#include"Grid.h"
+#include"GridOMP.h"
+#include"InitialState.h"
+#include"SteadyStateDetector.h"
+#include"Utils.h"
+
+#include<algorithm>
+#include<chrono>
+#include<fstream>
+#include<iostream>
+#include<sstream>
+
+//The engines are only made when the first job that needs them comes along
+JobRunner::JobRunner()
+{
+	serialGrid = nullptr;
+	ompGrid = nullptr;
+	defaultThreadCount = 1;
+}
+
+JobRunner::~JobRunner()
+{
+	delete serialGrid;
+	delete ompGrid;
+}
+
+//Returns the job that the settings of each line of a job file start from
+Job JobRunner::getDefaultJob()
+{
+	Job job;
+	job.rows = 1000;
+	job.cols = 1000;
+	job.seed = 16897;
+	job.sharkPercent = 25;
+	job.fishPercent = 50;
+	job.nIterations = 100;
+	job.openMP = true;
+	job.nThreads = 0;
+	job.lowMemory = false;
+	job.printStats = false;
+	job.randomSharkDeaths = true;
+	job.stopWhenSettled = false;
+	return job;
+}
+
+//Adds a job to the end of the list
+void JobRunner::addJob(const Job &job)
+{
+	jobs.push_back(job);
+}
+
+//Adds the jobs in a job file (see above) to the end of the list; lines that can't be read are reported and skipped
+//Returns false if the file couldn't be opened
+bool JobRunner::readJobs(std::string filePath)
+{
+	std::ifstream file(filePath);
+	if (!file.is_open())
+	{
+		std::cout << "Could not open the job file " << filePath << "!" << std::endl;
+		return false;
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		Job job;
+		if (parseJob(line, job))
+			addJob(job);
+		else
+			std::cout << "Skipping line " << lineNumber << " of " << filePath << ": " << line << std::endl;
+	}
+	return true;
+}
+
+//Runs all the jobs in order, printing how long each one took to set up and to run
+void JobRunner::runAll()
+{
+	//Start the OpenMP threads before the first job, so it isn't charged for them; the jobs that don't say how many
+	//threads to use get as many as the engine does by default, so it has to be made first
+	int nThreads = 0;
+	for (const Job &job : jobs)
+	{
+		if (job.openMP)
+			nThreads = std::max(nThreads, job.nThreads > 0 ? job.nThreads : getOMPGrid(job)->getTuning().nThreads);
+	}
+	if (nThreads > 0)
+	{
+#pragma omp parallel num_threads(nThreads)
+		{
+		}
+	}
+
+	for (size_t job = 0; job < jobs.size(); ++job)
+		runJob(static_cast<int>(job) + 1, jobs[job]);
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Reads a line of a job file into a job; returns false if it has settings that aren't known or can't be read
+bool JobRunner::parseJob(const std::string &line, Job &outJob)
+{
+	outJob = getDefaultJob();
+	std::istringstream settings(line);
+	std::string setting;
+	while (settings >> setting)
+	{
+		size_t equals = setting.find('=');
+		if (equals == std::string::npos)
+			return false;
+		std::string key = setting.substr(0, equals);
+		std::istringstream value(setting.substr(equals + 1));
+
+		bool isRead;
+		if (key == "rows")
+			isRead = static_cast<bool>(value >> outJob.rows) && outJob.rows > 0;
+		else if (key == "cols")
+			isRead = static_cast<bool>(value >> outJob.cols) && outJob.cols > 0;
+		else if (key == "seed")
+			isRead = static_cast<bool>(value >> outJob.seed);
+		else if (key == "sharks")
+			isRead = static_cast<bool>(value >> outJob.sharkPercent);
+		else if (key == "fish")
+			isRead = static_cast<bool>(value >> outJob.fishPercent);
+		else if (key == "iterations")
+			isRead = static_cast<bool>(value >> outJob.nIterations);
+		else if (key == "engine")
+		{
+			std::string engine = value.str();
+			outJob.openMP = engine == "omp";
+			isRead = engine == "omp" || engine == "serial";
+		}
+		else if (key == "threads")
+			isRead = static_cast<bool>(value >> outJob.nThreads);
+		else if (key == "lowmemory")
+			isRead = static_cast<bool>(value >> outJob.lowMemory);
+		else if (key == "initial")
+		{
+			outJob.initialStatePath = value.str();
+			isRead = true;
+		}
+		else if (key == "snapshot")
+		{
+			outJob.snapshotPath = value.str();
+			isRead = true;
+		}
+		else if (key == "stats")
+			isRead = static_cast<bool>(value >> outJob.printStats);
+		else if (key == "randomdeaths")
+			isRead = static_cast<bool>(value >> outJob.randomSharkDeaths);
+		else if (key == "settle")
+			isRead = static_cast<bool>(value >> outJob.stopWhenSettled);
+		else
+			isRead = false;
+
+		if (!isRead)
+			return false;
+	}
+	return true;
+}
+
+//Returns the engine for the OpenMP jobs, making it for the given job if there isn't one yet; its default number of
+//threads is kept for the jobs that don't say
+GridOMP *JobRunner::getOMPGrid(const Job &job)
+{
+	if (ompGrid == nullptr)
+	{
+		ompGrid = new GridOMP(job.rows, job.cols, job.lowMemory);
+		defaultThreadCount = ompGrid->getTuning().nThreads;
+	}
+	return ompGrid;
+}
+
+//Restarts the job's engine for it, runs it, and saves and prints what it asks for
+void JobRunner::runJob(int jobNumber, const Job &job)
+{
+	std::chrono::steady_clock::time_point setupStart = std::chrono::steady_clock::now();
+
+	//The engine is made before the seed is set, so that the random numbers it uses up don't make the first job
+	//different from the others
+	Grid *grid;
+	if (job.openMP)
+	{
+		getOMPGrid(job);
+		TuningConfig config = ompGrid->getTuning();
+		config.nThreads = job.nThreads > 0 ? job.nThreads : defaultThreadCount;
+		ompGrid->setTuning(config);
+		grid = ompGrid;
+	}
+	else
+	{
+		if (serialGrid == nullptr)
+			serialGrid = new Grid(job.rows, job.cols, job.lowMemory);
+		grid = serialGrid;
+	}
+
+	Utils::initUtils(job.seed);
+	grid->restart(job.rows, job.cols, job.sharkPercent, job.fishPercent, job.lowMemory);
+	if (!job.initialStatePath.empty())
+	{
+		InitialState initialState(job.initialStatePath);
+		initialState.setSeed(job.seed);
+		if (!grid->loadInitialState(initialState))
+		{
+			std::cout << "Job " << jobNumber << ": skipped, since its initial state couldn't be loaded" << std::endl;
+			return;
+		}
+	}
+
+	grid->setRandomSharkDeaths(job.randomSharkDeaths);
+	SteadyStateDetector detector;
+	if (job.stopWhenSettled)
+		grid->detectSteadyState(&detector);
+
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	if (job.openMP)
+		ompGrid->runTest(job.nIterations);
+	else
+		serialGrid->runTest(job.nIterations);
+	std::chrono::steady_clock::time_point runEnd = std::chrono::steady_clock::now();
+	//The detector goes away with this job
+	grid->detectSteadyState(nullptr);
+
+	//A job that settles can stop before all its iterations have been run
+	std::string generations = std::to_string(grid->getGeneration()) + " generations";
+	if (grid->getGeneration() < job.nIterations)
+		generations += " (of " + std::to_string(job.nIterations) + ", since it settled)";
+	std::cout << "Job " << jobNumber << ": " << job.rows << " x " << job.cols << ", " << generations << ", " << (job.openMP ? "omp on " + std::to_string(ompGrid->getTuning().nThreads) + " threads" : "serial")
+		<< ": set up in " << std::chrono::duration<double, std::milli>(runStart - setupStart).count() << " ms, ran in "
+		<< std::chrono::duration<double, std::milli>(runEnd - runStart).count() << " ms" << std::endl;
+	if (job.printStats)
+		grid->printStatsToConsole();
+	if (!job.snapshotPath.empty())
+		grid->saveSnapshot(job.snapshotPath);
+}
\ No newline at end of file
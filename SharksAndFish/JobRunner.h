@@ -0,0 +1,64 @@
+#pragma once
+#include<string>
+#include<vector>
+
+class Grid;
+class GridOMP;
+
+//One simulation for a JobRunner to run
+struct Job
+{
+	int rows, cols;
+	//The seed for Utils::initUtils, which the random grid and the sharks' random deaths come from
+	int seed;
+	int sharkPercent, fishPercent;
+	int nIterations;
+	//Whether to run it with GridOMP (on nThreads threads, or the engine's default if that's 0) or with Grid
+	bool openMP;
+	int nThreads;
+	bool lowMemory;
+	//If set, the grid starts from this map or pattern instead of the random one (see InitialState)
+	std::string initialStatePath;
+	//If set, the final grid is saved here (see Grid::saveSnapshot)
+	std::string snapshotPath;
+	//Whether to print the final number of sharks, fish and water cells
+	bool printStats;
+	//Whether sharks die of random causes (see Grid::setRandomSharkDeaths)
+	bool randomSharkDeaths;
+	//Whether to stop once nothing is left alive, and skip the whole cycles left once the grid repeats (see
+	//SteadyStateDetector)
+	bool stopWhenSettled;
+};
+
+/*Runs a list of simulations one after another in the same process, for sweeps over grid sizes, densities and seeds
+without paying for a new process, MPI_Init and the first allocation of the grids every time.
+One Grid and one GridOMP are kept for all the jobs and restarted for each one (see Grid::restart), so their memory is
+only allocated again when a job needs more of it than any before, and the OpenMP threads are started once, before the
+first job, and then kept waiting between jobs by the OpenMP runtime.
+
+Job files have one job per line, as key=value settings separated by spaces; settings that aren't given keep the
+values from getDefaultJob, and everything from # to the end of a line is ignored. The keys are rows, cols, seed, sharks,
+fish, iterations, engine (serial or omp), threads, lowmemory (0 or 1), initial, snapshot, stats (0 or 1), randomdeaths
+(0 or 1) and settle (0 or 1). eg-
+rows=2000 cols=2000 seed=3 sharks=10 fish=60 iterations=200 engine=omp threads=8 stats=1*/
+class JobRunner
+{
+public:
+	JobRunner();
+	~JobRunner();
+	static Job getDefaultJob();
+	void addJob(const Job &job);
+	bool readJobs(std::string filePath);
+	void runAll();
+
+protected:
+	std::vector<Job> jobs;
+	Grid *serialGrid;
+	GridOMP *ompGrid;
+	//The number of threads ompGrid uses for the jobs that don't say
+	int defaultThreadCount;
+
+	bool parseJob(const std::string &line, Job &outJob);
+	GridOMP *getOMPGrid(const Job &job);
+	void runJob(int jobNumber, const Job &job);
+};
\ No newline at end of file
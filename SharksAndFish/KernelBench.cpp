@@ -0,0 +1,193 @@
+#include"stdafx.h"
+#include"KernelBench.h"
+#include"Grid.h"
+#include"Utils.h"
+
+#include<chrono>
+#include<cstring>
+#include<iomanip>
+#include<iostream>
+#include<sstream>
+
+//The parts of a generation that are timed, in the order they're reported
+enum BenchPart { ghostCellsBenchPart, kernelBenchPart, flipBenchPart, nBenchParts };
+
+//Sets up a benchmark on grids of rows x cols cells, timing each mix over nIterations iterations
+KernelBench::KernelBench(int rows, int cols, int nIterations)
+{
+	this->rows = rows;
+	this->cols = cols;
+	this->nIterations = nIterations > 0 ? nIterations : 1;
+}
+
+//Runs every mix: all water, all fish, all sharks, the two checkerboards, and random mixes with shark and fish
+//percentages swept from 0 to 75, which include the 25 / 50 that runTest starts with
+void KernelBench::runAll()
+{
+	printHeader();
+	runMix(Mix::Water);
+	runMix(Mix::Fish);
+	runMix(Mix::Sharks);
+	runMix(Mix::FishCheckerboard);
+	runMix(Mix::SharkCheckerboard);
+	for (int sharkPercent = 0; sharkPercent <= 75; sharkPercent += 25)
+	{
+		for (int fishPercent = 0; sharkPercent + fishPercent <= 100 && fishPercent <= 75; fishPercent += 25)
+			runMix(Mix::Random, sharkPercent, fishPercent);
+	}
+}
+
+//Times the parts of a generation on a grid of the given mix and prints a row of the results
+//sharkPercent and fishPercent are only used by Mix::Random
+void KernelBench::runMix(Mix mix, int sharkPercent, int fishPercent)
+{
+	Grid grid(rows, cols);
+	std::vector<int> cells;
+	makeCells(mix, sharkPercent, fishPercent, cells);
+	std::vector<unsigned short> rowBuffers(5 * grid.cols);
+
+	using Clock = std::chrono::steady_clock;
+	double nanoseconds[nBenchParts] = {};
+	perfCounters.reset();
+	for (int i = 0; i < nIterations; ++i)
+	{
+		//Put the mix back, without the ghost cells, which are timed being filled in
+		for (int row = 0; row < rows; ++row)
+			memcpy(grid.currentGrid[row + 1] + 1, cells.data() + static_cast<size_t>(row) * cols, cols * sizeof(int));
+
+		//The same steps as calculateNextGridState and goToNextGridState, timed one by one
+		//The clock is read inside the counters' reads, so the time the counters take to read isn't part of the steps'
+		perfCounters.startPhase();
+		Clock::time_point start = Clock::now();
+		grid.updateGhostCells();
+		Clock::time_point end = Clock::now();
+		perfCounters.endPhase(ghostCellsPerfPhase);
+		nanoseconds[ghostCellsBenchPart] += std::chrono::duration<double, std::nano>(end - start).count();
+
+		perfCounters.startPhase();
+		start = Clock::now();
+		grid.calculateRows(1, grid.rows - 1, rowBuffers.data(), 32);
+		end = Clock::now();
+		perfCounters.endPhase(calculatePerfPhase);
+		nanoseconds[kernelBenchPart] += std::chrono::duration<double, std::nano>(end - start).count();
+
+		perfCounters.startPhase();
+		start = Clock::now();
+		grid.goToNextGridState();
+		end = Clock::now();
+		perfCounters.endPhase(goToNextPerfPhase);
+		nanoseconds[flipBenchPart] += std::chrono::duration<double, std::nano>(end - start).count();
+	}
+
+	printRow(getMixName(mix, sharkPercent, fishPercent), nanoseconds);
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Makes the cells of a grid of the given mix, row by row, without ghost cells
+//Fish and sharks are given random ages, so the ones reaching their maximum age are part of the mix too
+void KernelBench::makeCells(Mix mix, int sharkPercent, int fishPercent, std::vector<int> &outCells)
+{
+	outCells.resize(static_cast<size_t>(rows) * cols);
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			int &cell = outCells[static_cast<size_t>(row) * cols + col];
+			bool isBlack = (row + col) % 2 == 0;
+			switch (mix)
+			{
+			case Mix::Water:
+				cell = 0;
+				break;
+			case Mix::Fish:
+				cell = makeFish();
+				break;
+			case Mix::Sharks:
+				cell = makeShark();
+				break;
+			case Mix::FishCheckerboard:
+				cell = isBlack ? makeFish() : 0;
+				break;
+			case Mix::SharkCheckerboard:
+				cell = isBlack ? makeShark() : makeFish();
+				break;
+			case Mix::Random:
+				//The same way initGrid fills the grid
+				int temp = Utils::getRandomNumber(1, 100);
+				if (temp <= sharkPercent)
+					cell = makeShark();
+				else if (temp <= sharkPercent + fishPercent)
+					cell = makeFish();
+				else
+					cell = 0;
+				break;
+			}
+		}
+	}
+}
+
+//Returns a fish of a random age
+int KernelBench::makeFish()
+{
+	return Utils::getRandomNumber(1, maxFishAge);
+}
+
+//Returns a shark of a random age
+int KernelBench::makeShark()
+{
+	return -Utils::getRandomNumber(1, maxSharkAge);
+}
+
+//Returns the name a mix is reported under
+std::string KernelBench::getMixName(Mix mix, int sharkPercent, int fishPercent)
+{
+	switch (mix)
+	{
+	case Mix::Water:
+		return "all water";
+	case Mix::Fish:
+		return "all fish";
+	case Mix::Sharks:
+		return "all sharks";
+	case Mix::FishCheckerboard:
+		return "fish / water checkerboard";
+	case Mix::SharkCheckerboard:
+		return "shark / fish checkerboard";
+	default:
+		std::ostringstream name;
+		name << "random " << sharkPercent << "% sharks " << fishPercent << "% fish";
+		return name.str();
+	}
+}
+
+//Prints the headings of the columns printRow prints
+void KernelBench::printHeader()
+{
+	std::cout << "Kernel benchmark: " << rows << " x " << cols << " cells, " << nIterations << " iterations per mix\n";
+	std::cout << std::left << std::setw(30) << "mix" << std::right << std::setw(12) << "ghost ns" << std::setw(12)
+		<< "kernel ns" << std::setw(12) << "flip ns" << std::setw(16) << "misses / cell" << std::setw(12) << "miss rate"
+		<< "\n(ns are per cell per iteration; misses are the kernel's branch mispredictions)" << std::endl;
+}
+
+//Prints the results of a mix: the time each part took per cell per iteration and, if they were counted, the kernel's
+//branch misses
+void KernelBench::printRow(std::string name, const double *nanoseconds)
+{
+	double nCells = static_cast<double>(rows) * cols * nIterations;
+	std::cout << std::left << std::setw(30) << name << std::right << std::fixed << std::setprecision(3);
+	for (int part = 0; part < nBenchParts; ++part)
+		std::cout << std::setw(12) << nanoseconds[part] / nCells;
+
+	double branches = perfCounters.getTotal(calculatePerfPhase, branchesEvent);
+	double branchMisses = perfCounters.getTotal(calculatePerfPhase, branchMissesEvent);
+	if (branchMisses < 0)
+		std::cout << std::setw(16) << "n/a";
+	else
+		std::cout << std::setw(16) << branchMisses / nCells;
+	if (branchMisses < 0 || branches <= 0)
+		std::cout << std::setw(12) << "n/a";
+	else
+		std::cout << std::setw(11) << 100 * branchMisses / branches << "%";
+	std::cout << std::defaultfloat << std::endl;
+}
\ No newline at end of file
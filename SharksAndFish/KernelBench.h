@@ -0,0 +1,34 @@
+#pragma once
+#include"PerfCounters.h"
+#include<string>
+#include<vector>
+
+/*Times the three parts of a generation of Grid on their own: the ghost cell update, the rules being applied to every
+cell (the kernel), and making the next generation current (the flip), on grids made up of a chosen mix of cells
+instead of the one initGrid(25, 50) makes. How long the kernel takes depends a lot on the mix: every shark rolls a
+random number, fish and water go down different branches, and a mix of all three keeps the branch predictor guessing.
+
+The grid is put back to the mix before every iteration (which isn't timed), so each one is timed on the mix itself
+rather than on whatever it turns into. Each mix is reported as nanoseconds per cell for every part, and, where the
+performance counters are available, the kernel's branch mispredictions per cell and as a share of its branches.*/
+class KernelBench
+{
+public:
+	enum class Mix { Water, Fish, Sharks, FishCheckerboard, SharkCheckerboard, Random };
+
+	KernelBench(int rows, int cols, int nIterations);
+	void runAll();
+	void runMix(Mix mix, int sharkPercent = 0, int fishPercent = 0);
+
+protected:
+	int rows, cols, nIterations;
+	//Has to be opened before any parallel region (see PerfCounters)
+	PerfCounters perfCounters;
+
+	void makeCells(Mix mix, int sharkPercent, int fishPercent, std::vector<int> &outCells);
+	static int makeFish();
+	static int makeShark();
+	static std::string getMixName(Mix mix, int sharkPercent, int fishPercent);
+	void printHeader();
+	void printRow(std::string name, const double *nanoseconds);
+};
\ No newline at end of file
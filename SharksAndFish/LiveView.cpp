@@ -0,0 +1,277 @@
+#include"stdafx.h"
+#include"LiveView.h"
+#include"Snapshot.h"
+
+#include<algorithm>
+#include<iostream>
+#include<mpi.h>
+#include<opencv2\opencv.hpp>
+
+//Marks a cell in sentSpecies that hasn't been sent yet, so its tile counts as changed whatever the cell holds
+#define NOT_SENT 2
+
+static void appendInt(std::vector<unsigned char> &buffer, int value);
+static int readInt(const unsigned char *&position);
+
+//Creates a live view that gathers the grid on the process with rank viewerRank; if showWindow is set, the viewer
+//shows its copy of the grid in a window after each gather
+LiveView::LiveView(int viewerRank, bool showWindow)
+{
+	this->viewerRank = viewerRank;
+	this->showWindow = showWindow;
+	ownFirstRow = ownRows = ownCols = -1;
+	tilesDown = tilesAcross = 0;
+	mirrorRows = mirrorCols = 0;
+	lastTilesSent = lastBytesSent = lastTileCount = 0;
+}
+
+//Sends the tiles of this process' rows that have changed since the last gather to the viewer, which updates its copy
+//of the grid with them. grid holds rows rows of cols cells, including the ghost cells, of which the actual rows are
+//rows firstRow to firstRow + rows - 3 of the whole grid (totalRows rows without ghost rows).
+//This has to be called by all the processes in comm together
+void LiveView::gather(int **grid, int rows, int cols, int firstRow, int totalRows, MPI_Comm comm)
+{
+	int rank, nProcesses;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &nProcesses);
+	resize(rows, cols, firstRow);
+
+	//Compress the changed tiles in parallel, and then put them one after another in tile order
+	int nTiles = tilesDown * tilesAcross;
+	std::vector<std::vector<unsigned char>> tiles(nTiles);
+#pragma omp parallel for schedule(dynamic)
+	for (int tile = 0; tile < nTiles; ++tile)
+	{
+		if (isTileDirty(grid, tile / tilesAcross, tile % tilesAcross))
+			packTile(grid, tile / tilesAcross, tile % tilesAcross, tiles[tile]);
+	}
+	std::vector<unsigned char> localBytes;
+	for (const std::vector<unsigned char> &tile : tiles)
+		localBytes.insert(localBytes.end(), tile.begin(), tile.end());
+
+	//The viewer needs every process' rows and the size of its tiles before it can receive them
+	int localInfo[3] = { ownFirstRow, ownRows, static_cast<int>(localBytes.size()) };
+	std::vector<int> allInfo(rank == viewerRank ? 3 * nProcesses : 0);
+	MPI_Gather(localInfo, 3, MPI_INT, allInfo.data(), 3, MPI_INT, viewerRank, comm);
+
+	std::vector<int> sizes, offsets;
+	std::vector<unsigned char> allBytes;
+	if (rank == viewerRank)
+	{
+		sizes.resize(nProcesses);
+		offsets.resize(nProcesses);
+		int totalBytes = 0;
+		for (int process = 0; process < nProcesses; ++process)
+		{
+			sizes[process] = allInfo[3 * process + 2];
+			offsets[process] = totalBytes;
+			totalBytes += sizes[process];
+		}
+		allBytes.resize(std::max(totalBytes, 1));
+	}
+	MPI_Gatherv(localBytes.data(), static_cast<int>(localBytes.size()), MPI_UNSIGNED_CHAR, allBytes.data(),
+		sizes.data(), offsets.data(), MPI_UNSIGNED_CHAR, viewerRank, comm);
+
+	if (rank != viewerRank)
+		return;
+
+	if (mirrorRows != totalRows || mirrorCols != ownCols)
+	{
+		mirrorRows = totalRows;
+		mirrorCols = ownCols;
+		mirror.assign(static_cast<size_t>(mirrorRows) * mirrorCols, 0);
+	}
+
+	lastTilesSent = lastBytesSent = lastTileCount = 0;
+	for (int process = 0; process < nProcesses; ++process)
+	{
+		int processFirstRow = allInfo[3 * process], processRows = allInfo[3 * process + 1];
+		if (!unpackTiles(allBytes.data() + offsets[process], sizes[process], processFirstRow, processRows))
+			std::cout << "Could not update the live view with the tiles from process " << process << "!" << std::endl;
+		lastBytesSent += sizes[process];
+		lastTileCount += static_cast<long long>((processRows + liveViewTileSize - 1) / liveViewTileSize) * tilesAcross;
+	}
+
+	if (showWindow)
+		showMirror();
+}
+
+//Returns the species in the viewer's copy of the cell at the given row and column (counting from 0, without ghost
+//cells): 1 for a fish, -1 for a shark and 0 for water
+int LiveView::getMirrorCell(int row, int col)
+{
+	return mirror[static_cast<size_t>(row) * mirrorCols + col];
+}
+
+//Shows the viewer's copy of the grid in a window using OpenCV, without waiting for a key, so the same window can be
+//updated after every gather
+void LiveView::showMirror(std::string additionalInfo)
+{
+	using namespace cv;
+
+	Vec3b waterColour = Vec3b(255, 153, 153);	//light blue
+	Vec3b fishColour = Vec3b(102, 0, 204);		//maroon
+	Vec3b sharkColour = Vec3b(51, 255, 255);	//yellow
+
+	//Create the image (pixels will be empty)
+	Mat gridImage = Mat(mirrorRows, mirrorCols, CV_8UC3);
+
+	//Assign a colour to each pixel depending on what the corresponding cell contains
+	for (int row = 0; row < mirrorRows; ++row)
+	{
+		for (int col = 0; col < mirrorCols; ++col)
+		{
+			signed char species = mirror[static_cast<size_t>(row) * mirrorCols + col];
+			if (species > 0)		//fish
+				gridImage.at<Vec3b>(row, col) = fishColour;
+			else if (species == 0)	//empty
+				gridImage.at<Vec3b>(row, col) = waterColour;
+			else					//shark
+				gridImage.at<Vec3b>(row, col) = sharkColour;
+		}
+	}
+
+	cv::imshow("Sharks and Fish (live)" + std::string(" ") + additionalInfo, gridImage);
+	cv::waitKey(1);
+}
+
+//Prints how many tiles and bytes the viewer received in the last gather (on the viewer only)
+void LiveView::printLastGather()
+{
+	std::cout << "Live view: " << lastTilesSent << " of " << lastTileCount << " tiles changed, " << lastBytesSent
+		<< " bytes sent (" << static_cast<long long>(mirrorRows) * mirrorCols << " bytes as whole rows)" << std::endl;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Sets up the tiles for this process' rows, if they aren't the same as at the last gather; all of them are then sent
+//at the next gather
+void LiveView::resize(int rows, int cols, int firstRow)
+{
+	if (ownFirstRow == firstRow && ownRows == rows - 2 && ownCols == cols - 2)
+		return;
+
+	ownFirstRow = firstRow;
+	ownRows = rows - 2;
+	ownCols = cols - 2;
+	tilesDown = (ownRows + liveViewTileSize - 1) / liveViewTileSize;
+	tilesAcross = (ownCols + liveViewTileSize - 1) / liveViewTileSize;
+	sentSpecies.assign(static_cast<size_t>(ownRows) * ownCols, NOT_SENT);
+}
+
+//Returns whether the species in any cell of the tile has changed since it was last sent
+bool LiveView::isTileDirty(int **grid, int tileRow, int tileCol)
+{
+	int firstRow = tileRow * liveViewTileSize, firstCol = tileCol * liveViewTileSize;
+	int nRows = getTileCells(tileRow, ownRows), nCols = getTileCells(tileCol, ownCols);
+	for (int row = firstRow; row < firstRow + nRows; ++row)
+	{
+		const int *gridRow = grid[row + 1] + 1;
+		const signed char *sentRow = sentSpecies.data() + static_cast<size_t>(row) * ownCols;
+		for (int col = firstCol; col < firstCol + nCols; ++col)
+		{
+			if (getSpecies(gridRow[col]) != sentRow[col])
+				return true;
+		}
+	}
+	return false;
+}
+
+//Compresses the species in a tile into outBytes, as its index (4 bytes), the size of the compressed cells (4 bytes)
+//and the cells compressed with SnapshotCodec::compressBand, and remembers them as sent
+void LiveView::packTile(int **grid, int tileRow, int tileCol, std::vector<unsigned char> &outBytes)
+{
+	int firstRow = tileRow * liveViewTileSize, firstCol = tileCol * liveViewTileSize;
+	int nRows = getTileCells(tileRow, ownRows), nCols = getTileCells(tileCol, ownCols);
+
+	//The codec takes rows with a ghost cell in front, so each row of the tile gets one here too
+	std::vector<int> cells(static_cast<size_t>(nRows) * (nCols + 1));
+	std::vector<int*> cellRows(nRows);
+	for (int row = 0; row < nRows; ++row)
+	{
+		cellRows[row] = cells.data() + static_cast<size_t>(row) * (nCols + 1);
+		const int *gridRow = grid[firstRow + row + 1] + firstCol + 1;
+		signed char *sentRow = sentSpecies.data() + static_cast<size_t>(firstRow + row) * ownCols + firstCol;
+		for (int col = 0; col < nCols; ++col)
+		{
+			sentRow[col] = getSpecies(gridRow[col]);
+			cellRows[row][col + 1] = sentRow[col];
+		}
+	}
+
+	std::vector<unsigned char> compressed;
+	SnapshotCodec::compressBand(cellRows.data(), nRows, nCols, compressed);
+	appendInt(outBytes, tileRow * tilesAcross + tileCol);
+	appendInt(outBytes, static_cast<int>(compressed.size()));
+	outBytes.insert(outBytes.end(), compressed.begin(), compressed.end());
+}
+
+//Puts the tiles packed by a process whose rows are firstRow to firstRow + nRows - 1 into the mirror
+//Returns false if any of them is damaged or lies outside the grid
+bool LiveView::unpackTiles(const unsigned char *bytes, size_t size, int firstRow, int nRows)
+{
+	const unsigned char *position = bytes, *end = bytes + size;
+	int processTilesDown = (nRows + liveViewTileSize - 1) / liveViewTileSize;
+	if (firstRow < 0 || firstRow + nRows > mirrorRows)
+		return size == 0;
+
+	std::vector<int> cells;
+	std::vector<int*> cellRows;
+	while (position < end)
+	{
+		if (end - position < 8)
+			return false;
+		int tile = readInt(position), compressedSize = readInt(position);
+		if (tile < 0 || tile >= processTilesDown * tilesAcross || compressedSize < 0 || compressedSize > end - position)
+			return false;
+
+		int tileRow = tile / tilesAcross, tileCol = tile % tilesAcross;
+		int tileRows = getTileCells(tileRow, nRows), tileCols = getTileCells(tileCol, mirrorCols);
+		cells.resize(static_cast<size_t>(tileRows) * (tileCols + 1));
+		cellRows.resize(tileRows);
+		for (int row = 0; row < tileRows; ++row)
+			cellRows[row] = cells.data() + static_cast<size_t>(row) * (tileCols + 1);
+		if (!SnapshotCodec::decompressBand(position, compressedSize, cellRows.data(), tileRows, tileCols))
+			return false;
+		position += compressedSize;
+
+		int mirrorFirstRow = firstRow + tileRow * liveViewTileSize, mirrorFirstCol = tileCol * liveViewTileSize;
+		for (int row = 0; row < tileRows; ++row)
+		{
+			signed char *mirrorRow = mirror.data() + static_cast<size_t>(mirrorFirstRow + row) * mirrorCols;
+			for (int col = 0; col < tileCols; ++col)
+				mirrorRow[mirrorFirstCol + col] = static_cast<signed char>(cellRows[row][col + 1]);
+		}
+		++lastTilesSent;
+	}
+	return true;
+}
+
+//Returns the number of cells actually used in a tile along a side nCells cells long (the last tile may be short)
+int LiveView::getTileCells(int tile, int nCells)
+{
+	return std::min(liveViewTileSize, nCells - tile * liveViewTileSize);
+}
+
+//Returns the species of a cell: 1 for a fish, -1 for a shark and 0 for water
+signed char LiveView::getSpecies(int cell)
+{
+	return static_cast<signed char>((cell > 0) - (cell < 0));
+}
+
+//Appends a 4-byte little-endian integer to the buffer
+static void appendInt(std::vector<unsigned char> &buffer, int value)
+{
+	unsigned int bits = static_cast<unsigned int>(value);
+	for (int byte = 0; byte < 4; ++byte)
+		buffer.push_back(static_cast<unsigned char>(bits >> (8 * byte)));
+}
+
+//Reads a 4-byte little-endian integer, moving position past it
+static int readInt(const unsigned char *&position)
+{
+	unsigned int bits = 0;
+	for (int byte = 0; byte < 4; ++byte)
+		bits |= static_cast<unsigned int>(*position++) << (8 * byte);
+	return static_cast<int>(bits);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include<mpi.h>
+#include<string>
+#include<vector>
+
+//The number of rows and columns of cells in each tile that the live view tracks and sends on its own
+constexpr int liveViewTileSize = 64;
+
+/*Keeps a copy of a distributed grid on one process (the viewer), for watching a run while it goes, without every
+process sending all its rows to it the way stitchGrid does.
+Only the species in each cell is kept (fish, shark or water, not their ages), since that's all that is shown. Every
+process splits its own rows into tiles of liveViewTileSize x liveViewTileSize cells and remembers the species it last
+sent for each of them; at each gather, only the tiles where any cell's species has changed since then are compressed
+(see SnapshotCodec) and sent to the viewer, which puts them into its copy (the mirror). The first gather sends every
+tile. On a grid that has settled, most tiles don't change from one gather to the next, so the viewer's link carries a
+small part of the grid each time.
+
+Gathers are collective over the communicator; the processes' rows can move between gathers (such as after stitchGrid),
+in which case the tiles of the processes whose rows moved are all sent again.*/
+class LiveView
+{
+public:
+	LiveView(int viewerRank = 0, bool showWindow = true);
+	void gather(int **grid, int rows, int cols, int firstRow, int totalRows, MPI_Comm comm);
+	int getMirrorCell(int row, int col);
+	void showMirror(std::string additionalInfo = "");
+	void printLastGather();
+
+protected:
+	int viewerRank;
+	bool showWindow;
+
+	//This process' rows as of the last gather (counting from 0, without ghost rows), and the size of its tiles' grid
+	int ownFirstRow, ownRows, ownCols;
+	int tilesDown, tilesAcross;
+	//The species (-1, 0 or 1) of this process' cells as last sent to the viewer, row by row; 2 where nothing was sent
+	std::vector<signed char> sentSpecies;
+
+	//On the viewer: the whole grid's species, row by row, and its size
+	std::vector<signed char> mirror;
+	int mirrorRows, mirrorCols;
+	//On the viewer: the tiles and bytes received in the last gather, and how many tiles there were in all
+	long long lastTilesSent, lastBytesSent, lastTileCount;
+
+	void resize(int rows, int cols, int firstRow);
+	bool isTileDirty(int **grid, int tileRow, int tileCol);
+	void packTile(int **grid, int tileRow, int tileCol, std::vector<unsigned char> &outBytes);
+	bool unpackTiles(const unsigned char *bytes, size_t size, int firstRow, int nRows);
+	static int getTileCells(int tile, int nCells);
+	static signed char getSpecies(int cell);
+};
\ No newline at end of file
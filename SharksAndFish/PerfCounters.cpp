@@ -0,0 +1,198 @@
+#include"stdafx.h"
+#include"PerfCounters.h"
+
+#include<cstring>
+#include<iomanip>
+#include<iostream>
+#include<sstream>
+#include<mpi.h>
+
+#ifdef __linux__
+#include<linux/perf_event.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#endif
+
+static const char *eventNames[nPerfEvents] = { "cycles", "instructions", "LLC misses", "branches", "branch misses",
+	"CPU ms" };
+static const char *phaseNames[nPerfPhases] = { "calculateNextGridState", "goToNextGridState",
+	"updateGhostCells" };
+
+//Opens the counters; see above for when this has to happen
+PerfCounters::PerfCounters()
+{
+	for (int event = 0; event < nPerfEvents; ++event)
+		counters[event] = -1;
+
+#ifdef __linux__
+	//The type and config of each event, as perf_event_open wants them
+	const unsigned int types[nPerfEvents] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE };
+	const unsigned long long configs[nPerfEvents] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+		PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_TASK_CLOCK };
+
+	for (int event = 0; event < nPerfEvents; ++event)
+	{
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = types[event];
+		attributes.config = configs[event];
+		//Only the program itself is counted, which unprivileged users are allowed to do
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.inherit = 1;
+		//If there are more events than hardware counters, the kernel takes turns counting them; these say how long each
+		//one was actually counted, to scale it up by
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		counters[event] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+	}
+#endif
+
+	reset();
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	for (int event = 0; event < nPerfEvents; ++event)
+	{
+		if (counters[event] != -1)
+			close(counters[event]);
+	}
+#endif
+}
+
+//Returns whether any of the events can be counted
+bool PerfCounters::isAvailable()
+{
+	for (int event = 0; event < nPerfEvents; ++event)
+	{
+		if (counters[event] != -1)
+			return true;
+	}
+	return false;
+}
+
+//Clears the totals
+void PerfCounters::reset()
+{
+	for (int phase = 0; phase < nPerfPhases; ++phase)
+	{
+		for (int event = 0; event < nPerfEvents; ++event)
+			totals[phase][event] = 0;
+		nGenerations[phase] = 0;
+	}
+}
+
+//Call right before a phase starts
+void PerfCounters::startPhase()
+{
+	readCounters(phaseStartValues);
+}
+
+//Call right after a phase ends, to add what was counted since startPhase to the phase's totals
+void PerfCounters::endPhase(PerfPhase phase)
+{
+	double values[nPerfEvents];
+	readCounters(values);
+	for (int event = 0; event < nPerfEvents; ++event)
+		totals[phase][event] += values[event] - phaseStartValues[event];
+	++nGenerations[phase];
+}
+
+//Prints every event's count per generation and per cell (out of nCells) for each phase, plus the instructions per
+//cycle; under MPI every process prints its own, one after the other
+void PerfCounters::printReport(long long nCells)
+{
+	std::string report = makeReport(nCells);
+
+	int isMPIRunning, isMPIFinished, nProcesses = 1;
+	MPI_Initialized(&isMPIRunning);
+	MPI_Finalized(&isMPIFinished);
+	if (isMPIRunning && !isMPIFinished)
+		MPI_Comm_size(MPI_COMM_WORLD, &nProcesses);
+	if (nProcesses == 1)
+	{
+		std::cout << report << std::flush;
+		return;
+	}
+
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	for (int process = 0; process < nProcesses; ++process)
+	{
+		if (process == rank)
+			std::cout << "Process " << rank << ": " << report << std::flush;
+		MPI_Barrier(MPI_COMM_WORLD);
+	}
+}
+
+//Returns everything counted of the event during the phase since the last reset, or -1 if the event isn't counted
+double PerfCounters::getTotal(PerfPhase phase, PerfEvent event)
+{
+	return counters[event] != -1 ? totals[phase][event] : -1;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Reads the current value of every counter, scaled up for the time it wasn't being counted; 0 for the ones that
+//aren't open
+void PerfCounters::readCounters(double *outValues)
+{
+	for (int event = 0; event < nPerfEvents; ++event)
+	{
+		outValues[event] = 0;
+#ifdef __linux__
+		//The value, the time enabled and the time running
+		unsigned long long reading[3];
+		if (counters[event] == -1 || read(counters[event], reading, sizeof(reading)) != sizeof(reading))
+			continue;
+		outValues[event] = static_cast<double>(reading[0]);
+		if (reading[2] > 0 && reading[2] < reading[1])
+			outValues[event] *= static_cast<double>(reading[1]) / reading[2];
+#endif
+	}
+
+	//The task clock counts nanoseconds
+	outValues[taskClockEvent] /= 1e6;
+}
+
+//Makes the report printReport prints
+std::string PerfCounters::makeReport(long long nCells)
+{
+	std::ostringstream report;
+	if (!isAvailable())
+	{
+		report << "Performance counters are not available (they need Linux, and a perf_event_paranoid setting of 2 or "
+			"lower)\n";
+		return report.str();
+	}
+
+	report << "Performance counters over " << nGenerations[calculatePerfPhase] << " generations of " << nCells
+		<< " cells\n" << std::setprecision(4);
+	for (int phase = 0; phase < nPerfPhases; ++phase)
+	{
+		if (nGenerations[phase] == 0)
+			continue;
+
+		report << phaseNames[phase] << ":\n";
+		for (int event = 0; event < nPerfEvents; ++event)
+		{
+			report << "  " << std::left << std::setw(14) << eventNames[event] << std::right;
+			if (counters[event] == -1)
+			{
+				report << "n/a\n";
+				continue;
+			}
+			double perGeneration = totals[phase][event] / nGenerations[phase];
+			report << std::setw(12) << perGeneration << " per generation  " << std::setw(10)
+				<< perGeneration / (nCells > 0 ? nCells : 1) << " per cell\n";
+		}
+		if (counters[cyclesEvent] != -1 && counters[instructionsEvent] != -1 && totals[phase][cyclesEvent] > 0)
+			report << "  instructions per cycle: " << totals[phase][instructionsEvent] / totals[phase][cyclesEvent] << "\n";
+	}
+	return report.str();
+}
\ No newline at end of file
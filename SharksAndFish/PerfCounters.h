@@ -0,0 +1,71 @@
+#pragma once
+#include<string>
+
+//The hardware (and one software) events that are counted
+enum PerfEvent { cyclesEvent, instructionsEvent, cacheMissesEvent, branchesEvent, branchMissesEvent, taskClockEvent,
+	nPerfEvents };
+
+//The phases of a generation that are counted separately
+//The ghost cell update is part of calculateNextGridState, and is only counted on its own by KernelBench
+enum PerfPhase { calculatePerfPhase, goToNextPerfPhase, ghostCellsPerfPhase, nPerfPhases };
+
+/*Counts CPU cycles, instructions, last level cache misses, branches, branch mispredictions and CPU time around each
+phase of a generation, using the kernel's perf_event_open (Linux only; elsewhere, or if the kernel won't allow it,
+nothing is counted and the report says so). Events the CPU doesn't have are left out on their own.
+
+The counters follow this process and every thread it starts after they are opened, so a PerfCounters has to be
+created before the engine's first parallel region, or the threads OpenMP keeps around won't be counted. Under MPI,
+each process counts its own work and the report comes out once per process, in order of rank.*/
+class PerfCounters
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+	bool isAvailable();
+	template<class GridType>
+	void profile(GridType &grid, int nIterations, long long nCells);
+	void reset();
+	void startPhase();
+	void endPhase(PerfPhase phase);
+	void printReport(long long nCells);
+	double getTotal(PerfPhase phase, PerfEvent event);
+
+protected:
+	//File descriptors of the counters, -1 for the ones that couldn't be opened
+	int counters[nPerfEvents];
+	double phaseStartValues[nPerfEvents];
+	double totals[nPerfPhases][nPerfEvents];
+	int nGenerations[nPerfPhases];
+
+	void readCounters(double *outValues);
+	std::string makeReport(long long nCells);
+
+	//For the engines that make the new generation current at the end of calculateNextGridState, and so have no
+	//goToNextGridState (GridStream)
+	template<class GridType>
+	static auto goToNextGridState(GridType &grid, int) -> decltype(grid.goToNextGridState(), void())
+	{
+		grid.goToNextGridState();
+	}
+	template<class GridType>
+	static void goToNextGridState(GridType &grid, long) {}
+};
+
+//Runs the grid for nIterations the way runTest does, counting calculateNextGridState and goToNextGridState
+//separately, and prints the report; nCells is the number of cells this process calculates per generation
+template<class GridType>
+void PerfCounters::profile(GridType &grid, int nIterations, long long nCells)
+{
+	reset();
+	for (int i = 0; i < nIterations; ++i)
+	{
+		startPhase();
+		grid.calculateNextGridState();
+		endPhase(calculatePerfPhase);
+
+		startPhase();
+		goToNextGridState(grid, 0);
+		endPhase(goToNextPerfPhase);
+	}
+	printReport(nCells);
+}
\ No newline at end of file
@@ -0,0 +1,589 @@
+#include"stdafx.h"
+#include"Snapshot.h"
+#include"HistoryLog.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<queue>
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 20
+#define SNAPSHOT_INDEX_ENTRY_SIZE 24
+//The longest Huffman code, in bits; the decoder looks codes up in a table of 2^HUFFMAN_MAX_BITS entries
+#define HUFFMAN_MAX_BITS 12
+
+//How a band's bytes are stored (the first byte of every compressed band)
+enum BandMethod { runsOnlyMethod, huffmanMethod };
+
+static void appendFixed(std::vector<unsigned char> &buffer, unsigned long long value, int nBytes);
+static unsigned long long readFixed(const unsigned char *&position, int nBytes);
+static void appendHeader(std::vector<unsigned char> &buffer, int rows, int cols, int nBands);
+static bool readVarint(const unsigned char *&position, const unsigned char *end, unsigned long long &outValue);
+static void buildCodeLengths(const unsigned long long *counts, unsigned char *outLengths);
+static void assignCodes(const unsigned char *lengths, unsigned int *outCodes);
+
+//Bands are bandRows rows each (the last one may be shorter); more bands compress in parallel better, but each one
+//carries its own code table of 128 bytes
+SnapshotWriter::SnapshotWriter(int bandRows)
+{
+	this->bandRows = bandRows > 0 ? bandRows : 1;
+}
+
+//Writes the grid to a snapshot file, replacing whatever was there; rows and cols include the ghost cells, which are not
+//written. Returns false if the file couldn't be written.
+bool SnapshotWriter::write(std::string filePath, int **grid, int rows, int cols)
+{
+	compressBands(grid, rows, cols, 0);
+
+	std::vector<unsigned char> header;
+	appendHeader(header, rows - 2, cols - 2, static_cast<int>(index.size()));
+	placeBands(SNAPSHOT_HEADER_SIZE + static_cast<long long>(index.size()) * SNAPSHOT_INDEX_ENTRY_SIZE);
+	appendIndex(header);
+
+	std::ofstream file(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Could not open " << filePath << " to write the snapshot to!" << std::endl;
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(header.data()), header.size());
+	for (const std::vector<unsigned char> &band : bands)
+		file.write(reinterpret_cast<const char*>(band.data()), band.size());
+	return file.good();
+}
+
+//Writes one snapshot file of a grid that is split between the processes in comm, each of which has to call this with
+//its own part: rows x cols cells (including the ghost cells) holding the grid's rows from firstRow on, out of
+//totalRows. A process with no rows of its own passes a rows of 2.
+//Each process compresses its own bands and writes them straight into the file, next to the others'.
+//Returns false on every process if any of them couldn't write its part.
+bool SnapshotWriter::writeDistributed(std::string filePath, int **grid, int rows, int cols, int firstRow, int totalRows,
+	MPI_Comm comm)
+{
+	int rank;
+	MPI_Comm_rank(comm, &rank);
+	compressBands(grid, rows, cols, firstRow);
+
+	//The processes' bands go into the index and the file in order of rank, which is also the order of their rows
+	long long localBytes = 0, bytesBefore = 0;
+	for (const std::vector<unsigned char> &band : bands)
+		localBytes += band.size();
+	int localBands = static_cast<int>(index.size()), bandsBefore = 0, totalBands = 0;
+	MPI_Exscan(&localBytes, &bytesBefore, 1, MPI_LONG_LONG, MPI_SUM, comm);
+	MPI_Exscan(&localBands, &bandsBefore, 1, MPI_INT, MPI_SUM, comm);
+	MPI_Allreduce(&localBands, &totalBands, 1, MPI_INT, MPI_SUM, comm);
+	//MPI_Exscan leaves process 0's results undefined
+	if (rank == 0)
+	{
+		bytesBefore = 0;
+		bandsBefore = 0;
+	}
+	placeBands(SNAPSHOT_HEADER_SIZE + static_cast<long long>(totalBands) * SNAPSHOT_INDEX_ENTRY_SIZE + bytesBefore);
+
+	//Process 0 writes the header along with its part of the index
+	std::vector<unsigned char> header;
+	if (rank == 0)
+		appendHeader(header, totalRows, cols - 2, totalBands);
+	appendIndex(header);
+	MPI_Offset headerOffset = rank == 0 ? 0 : SNAPSHOT_HEADER_SIZE + static_cast<MPI_Offset>(bandsBefore) *
+		SNAPSHOT_INDEX_ENTRY_SIZE;
+
+	MPI_File file;
+	if (MPI_File_open(comm, filePath.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+	{
+		if (rank == 0)
+			std::cout << "Could not open " << filePath << " to write the snapshot to!" << std::endl;
+		return false;
+	}
+	//Otherwise whatever was at the end of an older, bigger file would stay there
+	MPI_File_set_size(file, 0);
+
+	int written = MPI_File_write_at(file, headerOffset, header.data(), static_cast<int>(header.size()), MPI_BYTE,
+		MPI_STATUS_IGNORE) == MPI_SUCCESS;
+	for (size_t band = 0; band < bands.size(); ++band)
+	{
+		written &= MPI_File_write_at(file, index[band].offset, bands[band].data(), static_cast<int>(bands[band].size()),
+			MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+	}
+	MPI_File_close(&file);
+
+	int allWritten;
+	MPI_Allreduce(&written, &allWritten, 1, MPI_INT, MPI_LAND, comm);
+	if (!allWritten && rank == 0)
+		std::cout << "Could not write the snapshot to " << filePath << "!" << std::endl;
+	return allWritten != 0;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Splits the grid's rows (without the ghost cells) into bands and compresses them all, in parallel
+//firstRow is the row of the whole grid that the grid's first row is, for the index
+void SnapshotWriter::compressBands(int **grid, int rows, int cols, int firstRow)
+{
+	int nRows = rows - 2;
+	int nBands = (nRows + bandRows - 1) / bandRows;
+	index.resize(nBands);
+	bands.resize(nBands);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int band = 0; band < nBands; ++band)
+	{
+		int bandFirstRow = band * bandRows;
+		int bandRowCount = std::min(bandRows, nRows - bandFirstRow);
+		SnapshotCodec::compressBand(grid + 1 + bandFirstRow, bandRowCount, cols - 2, bands[band]);
+
+		index[band].firstRow = firstRow + bandFirstRow;
+		index[band].nRows = bandRowCount;
+		index[band].size = static_cast<long long>(bands[band].size());
+	}
+}
+
+//Sets the bands' offsets, one right after another from firstOffset
+void SnapshotWriter::placeBands(long long firstOffset)
+{
+	for (SnapshotBand &band : index)
+	{
+		band.offset = firstOffset;
+		firstOffset += band.size;
+	}
+}
+
+//Appends the bands' entries of the index to the buffer
+void SnapshotWriter::appendIndex(std::vector<unsigned char> &buffer)
+{
+	for (const SnapshotBand &band : index)
+	{
+		appendFixed(buffer, band.firstRow, 4);
+		appendFixed(buffer, band.nRows, 4);
+		appendFixed(buffer, band.offset, 8);
+		appendFixed(buffer, band.size, 8);
+	}
+}
+
+//Opens a snapshot file and reads its index
+//If the file can't be read, or its index doesn't cover the grid's rows exactly once, the reader is left invalid
+SnapshotReader::SnapshotReader(std::string filePath)
+{
+	rows = 0;
+	cols = 0;
+
+	file.open(filePath, std::ios::in | std::ios::binary);
+	file.seekg(0, std::ios::end);
+	long long fileSize = file ? static_cast<long long>(file.tellg()) : 0;
+	file.seekg(0);
+
+	unsigned char header[SNAPSHOT_HEADER_SIZE];
+	const unsigned char *position = header + 4;
+	bool isReadable = file.read(reinterpret_cast<char*>(header), SNAPSHOT_HEADER_SIZE) && memcmp(header, "SFSN", 4) == 0
+		&& readFixed(position, 4) == SNAPSHOT_VERSION;
+	if (isReadable)
+	{
+		int headerRows = static_cast<int>(readFixed(position, 4));
+		int headerCols = static_cast<int>(readFixed(position, 4));
+		int nBands = static_cast<int>(readFixed(position, 4));
+
+		isReadable = headerRows > 0 && headerCols > 0 && nBands > 0
+			&& SNAPSHOT_HEADER_SIZE + static_cast<long long>(nBands) * SNAPSHOT_INDEX_ENTRY_SIZE <= fileSize;
+		std::vector<unsigned char> indexBytes(isReadable ? static_cast<size_t>(nBands) * SNAPSHOT_INDEX_ENTRY_SIZE : 0);
+		isReadable = isReadable && file.read(reinterpret_cast<char*>(indexBytes.data()), indexBytes.size());
+		position = indexBytes.data();
+		int nextRow = 0;
+		for (int band = 0; band < nBands && isReadable; ++band)
+		{
+			SnapshotBand entry;
+			entry.firstRow = static_cast<int>(readFixed(position, 4));
+			entry.nRows = static_cast<int>(readFixed(position, 4));
+			entry.offset = static_cast<long long>(readFixed(position, 8));
+			entry.size = static_cast<long long>(readFixed(position, 8));
+			isReadable = entry.firstRow == nextRow && entry.nRows > 0 && entry.offset >= 0 && entry.size > 0
+				&& entry.offset + entry.size <= fileSize;
+			nextRow += entry.nRows;
+			index.push_back(entry);
+		}
+		isReadable = isReadable && nextRow == headerRows;
+
+		rows = headerRows;
+		cols = headerCols;
+	}
+
+	if (!isReadable)
+	{
+		std::cout << "Could not read the snapshot in " << filePath << "!" << std::endl;
+		rows = 0;
+		cols = 0;
+		index.clear();
+	}
+}
+
+//Returns whether the file was read as a snapshot
+bool SnapshotReader::isValid()
+{
+	return rows > 0;
+}
+
+int SnapshotReader::getRows()
+{
+	return rows;
+}
+
+int SnapshotReader::getCols()
+{
+	return cols;
+}
+
+int SnapshotReader::getBandCount()
+{
+	return static_cast<int>(index.size());
+}
+
+//Puts nRows of the snapshot's rows, from firstRow on, into grid's rows from 1 on, leaving the ghost cells alone; grid
+//must be getCols() + 2 columns wide. Only the bands holding those rows are read, and they are decompressed in parallel.
+//Returns false if the rows aren't all in the snapshot or couldn't be read.
+bool SnapshotReader::readRows(int firstRow, int nRows, int **grid)
+{
+	if (firstRow < 0 || nRows < 0 || firstRow + nRows > rows)
+		return false;
+
+	//Read the bands that overlap the rows, one after the other
+	std::vector<int> neededBands;
+	for (int band = 0; band < getBandCount(); ++band)
+	{
+		if (index[band].firstRow < firstRow + nRows && index[band].firstRow + index[band].nRows > firstRow)
+			neededBands.push_back(band);
+	}
+	std::vector<std::vector<unsigned char>> compressedBands(neededBands.size());
+	for (size_t i = 0; i < neededBands.size(); ++i)
+	{
+		const SnapshotBand &band = index[neededBands[i]];
+		compressedBands[i].resize(static_cast<size_t>(band.size));
+		file.seekg(band.offset);
+		file.read(reinterpret_cast<char*>(compressedBands[i].data()), band.size);
+	}
+	if (!file)
+	{
+		file.clear();
+		return false;
+	}
+
+	int nFailed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:nFailed)
+	for (int i = 0; i < static_cast<int>(neededBands.size()); ++i)
+	{
+		const SnapshotBand &band = index[neededBands[i]];
+
+		//The band's rows that weren't asked for are decompressed into a spare row, and thrown away
+		std::vector<int> spareRow(cols + 2);
+		std::vector<int*> bandRows(band.nRows);
+		for (int row = 0; row < band.nRows; ++row)
+		{
+			int gridRow = band.firstRow + row - firstRow;
+			bandRows[row] = gridRow >= 0 && gridRow < nRows ? grid[gridRow + 1] : spareRow.data();
+		}
+
+		if (!SnapshotCodec::decompressBand(compressedBands[i].data(), compressedBands[i].size(), bandRows.data(),
+			band.nRows, cols))
+			++nFailed;
+	}
+	return nFailed == 0;
+}
+
+/*Compresses nRows rows of cols cells each, where the cells of rows[row] are at rows[row][1] to rows[row][cols] (so rows
+can be a grid's row pointers; the ghost cells are left out), and puts the result in outBytes.
+The cells are first turned into runs: (value, run length - 1) pairs, the value as a byte and the length as a
+variable-length integer, with the runs carrying on from one row to the next. The runs are then Huffman coded, with
+codes of up to HUFFMAN_MAX_BITS bits written lowest bit first, unless that wouldn't make them any smaller.
+Layout: method (1 byte, see BandMethod), size of the runs in bytes (variable-length), and then either the runs as
+they are, or the code lengths of all 256 byte values (4 bits each, 128 bytes) followed by the coded runs.*/
+void SnapshotCodec::compressBand(int *const *rows, int nRows, int cols, std::vector<unsigned char> &outBytes)
+{
+	std::vector<unsigned char> runs;
+	int runValue = rows[0][1];
+	unsigned long long runLength = 0;
+	for (int row = 0; row < nRows; ++row)
+	{
+		const int *cells = rows[row] + 1;
+		for (int col = 0; col < cols; ++col)
+		{
+			if (cells[col] != runValue)
+			{
+				runs.push_back(static_cast<unsigned char>(runValue));
+				HistoryLog::appendVarint(runs, runLength - 1);
+				runValue = cells[col];
+				runLength = 0;
+			}
+			++runLength;
+		}
+	}
+	runs.push_back(static_cast<unsigned char>(runValue));
+	HistoryLog::appendVarint(runs, runLength - 1);
+
+	unsigned long long counts[256] = {};
+	for (unsigned char byte : runs)
+		++counts[byte];
+	unsigned char lengths[256];
+	buildCodeLengths(counts, lengths);
+	unsigned long long codedBits = 0;
+	for (int symbol = 0; symbol < 256; ++symbol)
+		codedBits += counts[symbol] * lengths[symbol];
+
+	outBytes.clear();
+	if (128 + (codedBits + 7) / 8 >= runs.size())
+	{
+		outBytes.push_back(runsOnlyMethod);
+		HistoryLog::appendVarint(outBytes, runs.size());
+		outBytes.insert(outBytes.end(), runs.begin(), runs.end());
+		return;
+	}
+
+	outBytes.push_back(huffmanMethod);
+	HistoryLog::appendVarint(outBytes, runs.size());
+	for (int symbol = 0; symbol < 256; symbol += 2)
+		outBytes.push_back(static_cast<unsigned char>(lengths[symbol] | lengths[symbol + 1] << 4));
+
+	unsigned int codes[256];
+	assignCodes(lengths, codes);
+	outBytes.reserve(outBytes.size() + static_cast<size_t>((codedBits + 7) / 8));
+	unsigned long long bitBuffer = 0;
+	int bitCount = 0;
+	for (unsigned char byte : runs)
+	{
+		bitBuffer |= static_cast<unsigned long long>(codes[byte]) << bitCount;
+		bitCount += lengths[byte];
+		while (bitCount >= 8)
+		{
+			outBytes.push_back(static_cast<unsigned char>(bitBuffer));
+			bitBuffer >>= 8;
+			bitCount -= 8;
+		}
+	}
+	if (bitCount > 0)
+		outBytes.push_back(static_cast<unsigned char>(bitBuffer));
+}
+
+//Decompresses a band written by compressBand into rows (laid out as compressBand takes them)
+//Returns false if the band is damaged, or doesn't hold exactly nRows x cols cells
+bool SnapshotCodec::decompressBand(const unsigned char *bytes, size_t size, int *const *rows, int nRows, int cols)
+{
+	const unsigned char *position = bytes, *end = bytes + size;
+	if (size < 1)
+		return false;
+	int method = *position++;
+	unsigned long long runsSize;
+	if (!readVarint(position, end, runsSize))
+		return false;
+
+	std::vector<unsigned char> decodedRuns;
+	const unsigned char *runs = position, *runsEnd;
+	if (method == runsOnlyMethod)
+	{
+		if (runsSize > static_cast<unsigned long long>(end - position))
+			return false;
+		runsEnd = position + runsSize;
+	}
+	else if (method == huffmanMethod)
+	{
+		//Every code is at least a bit long
+		if (end - position < 128 || runsSize > static_cast<unsigned long long>(end - position - 128) * 8)
+			return false;
+		unsigned char lengths[256];
+		for (int symbol = 0; symbol < 256; symbol += 2)
+		{
+			lengths[symbol] = *position & 0xF;
+			lengths[symbol + 1] = *position++ >> 4;
+		}
+
+		//Every HUFFMAN_MAX_BITS-bit pattern maps to the symbol whose code it starts with, and the code's length;
+		//patterns no code starts with are left at 0
+		std::vector<unsigned short> table(1 << HUFFMAN_MAX_BITS, 0);
+		unsigned int codes[256];
+		assignCodes(lengths, codes);
+		for (int symbol = 0; symbol < 256; ++symbol)
+		{
+			if (lengths[symbol] > HUFFMAN_MAX_BITS)
+				return false;
+			if (lengths[symbol] == 0)
+				continue;
+			for (unsigned int pattern = codes[symbol]; pattern < table.size(); pattern += 1u << lengths[symbol])
+				table[pattern] = static_cast<unsigned short>(symbol | lengths[symbol] << 8);
+		}
+
+		decodedRuns.resize(static_cast<size_t>(runsSize));
+		unsigned long long bitBuffer = 0;
+		int bitCount = 0;
+		for (size_t i = 0; i < decodedRuns.size(); ++i)
+		{
+			while (bitCount <= 56 && position < end)
+			{
+				bitBuffer |= static_cast<unsigned long long>(*position++) << bitCount;
+				bitCount += 8;
+			}
+			unsigned short entry = table[bitBuffer & ((1 << HUFFMAN_MAX_BITS) - 1)];
+			int length = entry >> 8;
+			if (length == 0 || length > bitCount)
+				return false;
+			decodedRuns[i] = static_cast<unsigned char>(entry);
+			bitBuffer >>= length;
+			bitCount -= length;
+		}
+		runs = decodedRuns.data();
+		runsEnd = runs + decodedRuns.size();
+	}
+	else
+		return false;
+
+	//Lay the runs out over the rows
+	int row = 0, col = 0;
+	while (runs < runsEnd)
+	{
+		int value = static_cast<signed char>(*runs++);
+		unsigned long long runLength;
+		if (!readVarint(runs, runsEnd, runLength))
+			return false;
+		for (++runLength; runLength > 0;)
+		{
+			if (row == nRows)
+				return false;
+			int nCells = static_cast<int>(std::min<unsigned long long>(runLength, cols - col));
+			std::fill(rows[row] + 1 + col, rows[row] + 1 + col + nCells, value);
+			col += nCells;
+			runLength -= nCells;
+			if (col == cols)
+			{
+				col = 0;
+				++row;
+			}
+		}
+	}
+	return row == nRows;
+}
+
+//Appends the lowest nBytes bytes of value to the buffer, lowest byte first
+static void appendFixed(std::vector<unsigned char> &buffer, unsigned long long value, int nBytes)
+{
+	for (int byte = 0; byte < nBytes; ++byte)
+		buffer.push_back(static_cast<unsigned char>(value >> (8 * byte)));
+}
+
+//Reads a value written by appendFixed, and moves position past it
+static unsigned long long readFixed(const unsigned char *&position, int nBytes)
+{
+	unsigned long long value = 0;
+	for (int byte = 0; byte < nBytes; ++byte)
+		value |= static_cast<unsigned long long>(*position++) << (8 * byte);
+	return value;
+}
+
+//Appends a snapshot file's header to the buffer; rows and cols are without the ghost cells
+static void appendHeader(std::vector<unsigned char> &buffer, int rows, int cols, int nBands)
+{
+	buffer.insert(buffer.end(), { 'S', 'F', 'S', 'N' });
+	appendFixed(buffer, SNAPSHOT_VERSION, 4);
+	appendFixed(buffer, rows, 4);
+	appendFixed(buffer, cols, 4);
+	appendFixed(buffer, nBands, 4);
+}
+
+//Reads an unsigned integer written by HistoryLog::appendVarint, and moves position past it; returns false if it would
+//go past end
+static bool readVarint(const unsigned char *&position, const unsigned char *end, unsigned long long &outValue)
+{
+	outValue = 0;
+	for (int shift = 0; shift < 64 && position < end; shift += 7)
+	{
+		unsigned char byte = *position++;
+		outValue |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+//Works out the length of each byte value's Huffman code from how many times it appears (0 for the ones that don't)
+//If any code comes out longer than HUFFMAN_MAX_BITS, the counts are halved, which evens them out, until none does.
+static void buildCodeLengths(const unsigned long long *counts, unsigned char *outLengths)
+{
+	unsigned long long weights[256];
+	memcpy(weights, counts, sizeof(weights));
+
+	while (true)
+	{
+		memset(outLengths, 0, 256);
+
+		//Nodes 0 to 255 are the byte values, and the ones after are made by joining the two lightest nodes left
+		typedef std::pair<unsigned long long, int> WeightedNode;
+		std::priority_queue<WeightedNode, std::vector<WeightedNode>, std::greater<WeightedNode>> queue;
+		for (int symbol = 0; symbol < 256; ++symbol)
+		{
+			if (weights[symbol] > 0)
+				queue.push({ weights[symbol], symbol });
+		}
+		if (queue.size() == 1)
+		{
+			outLengths[queue.top().second] = 1;
+			return;
+		}
+
+		int parents[511];
+		int nextNode = 256;
+		while (queue.size() > 1)
+		{
+			WeightedNode first = queue.top();
+			queue.pop();
+			WeightedNode second = queue.top();
+			queue.pop();
+			parents[first.second] = parents[second.second] = nextNode;
+			queue.push({ first.first + second.first, nextNode++ });
+		}
+
+		//Parents always come after their children, so the depths can be worked out from the root down
+		int depths[511];
+		int root = nextNode - 1;
+		depths[root] = 0;
+		for (int node = root - 1; node >= 256; --node)
+			depths[node] = depths[parents[node]] + 1;
+
+		int longestCode = 0;
+		for (int symbol = 0; symbol < 256; ++symbol)
+		{
+			if (weights[symbol] == 0)
+				continue;
+			outLengths[symbol] = static_cast<unsigned char>(depths[parents[symbol]] + 1);
+			longestCode = std::max<int>(longestCode, outLengths[symbol]);
+		}
+		if (longestCode <= HUFFMAN_MAX_BITS)
+			return;
+
+		for (int symbol = 0; symbol < 256; ++symbol)
+			weights[symbol] = (weights[symbol] + 1) / 2;
+	}
+}
+
+//Gives every byte value with a code length its canonical Huffman code (the codes of each length counting up in order
+//of byte value, after all the shorter ones), bit-reversed so that it can be written and read lowest bit first
+static void assignCodes(const unsigned char *lengths, unsigned int *outCodes)
+{
+	int lengthCounts[16] = {};
+	for (int symbol = 0; symbol < 256; ++symbol)
+		++lengthCounts[lengths[symbol] & 0xF];
+	lengthCounts[0] = 0;
+
+	unsigned int nextCodes[16] = {};
+	unsigned int code = 0;
+	for (int length = 1; length < 16; ++length)
+	{
+		code = (code + lengthCounts[length - 1]) << 1;
+		nextCodes[length] = code;
+	}
+
+	for (int symbol = 0; symbol < 256; ++symbol)
+	{
+		int length = lengths[symbol] & 0xF;
+		outCodes[symbol] = 0;
+		if (length == 0)
+			continue;
+		unsigned int canonicalCode = nextCodes[length]++;
+		for (int bit = 0; bit < length; ++bit)
+			outCodes[symbol] |= ((canonicalCode >> bit) & 1) << (length - 1 - bit);
+	}
+}
\ No newline at end of file
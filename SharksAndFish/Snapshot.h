@@ -0,0 +1,66 @@
+#pragma once
+#include<fstream>
+#include<string>
+#include<vector>
+#include<mpi.h>
+
+/*Writes whole grids to compressed snapshot files, and reads them back.
+The grid is split into bands of bandRows rows, and each band is compressed on its own, in parallel: first as runs of
+cells with the same value, and then with a Huffman code built for the band's bytes. Water, young fish and the
+one-cell runs that make up most of a busy grid each end up taking a few bits instead of a whole byte or int. An index
+at the start of the file says where each band is, so a reader can pick out just the bands it needs and decompress
+them in parallel too.
+Under MPI, each process compresses its own rows and writes them into the file at the same time as the others.
+
+File layout (all integers are little-endian, of the given number of bytes):
+header: "SFSN", version (4), rows (4), cols (4), number of bands (4)
+index:  for each band: first row (4), number of rows (4), offset in the file (8), compressed size in bytes (8)
+bands:  the compressed bands (see SnapshotCodec::compressBand)*/
+
+//Where a band of rows is kept in a snapshot file
+struct SnapshotBand
+{
+	int firstRow, nRows;
+	long long offset, size;
+};
+
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(int bandRows = 64);
+	bool write(std::string filePath, int **grid, int rows, int cols);
+	bool writeDistributed(std::string filePath, int **grid, int rows, int cols, int firstRow, int totalRows,
+		MPI_Comm comm);
+
+protected:
+	int bandRows;
+	std::vector<SnapshotBand> index;
+	std::vector<std::vector<unsigned char>> bands;
+
+	void compressBands(int **grid, int rows, int cols, int firstRow);
+	void placeBands(long long firstOffset);
+	void appendIndex(std::vector<unsigned char> &buffer);
+};
+
+class SnapshotReader
+{
+public:
+	SnapshotReader(std::string filePath);
+	bool isValid();
+	int getRows();
+	int getCols();
+	int getBandCount();
+	bool readRows(int firstRow, int nRows, int **grid);
+
+protected:
+	std::ifstream file;
+	int rows, cols;
+	std::vector<SnapshotBand> index;
+};
+
+//The compression of a single band, shared by the writer and the reader
+namespace SnapshotCodec
+{
+	void compressBand(int *const *rows, int nRows, int cols, std::vector<unsigned char> &outBytes);
+	bool decompressBand(const unsigned char *bytes, size_t size, int *const *rows, int nRows, int cols);
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include"stdafx.h"
+#include"SteadyStateDetector.h"
+
+#include<iostream>
+
+//Creates a detector that looks for cycles of up to maxPeriod generations; if fastForward is set, skipAhead skips the
+//whole cycles left in a run once one is found, and otherwise it's only reported
+SteadyStateDetector::SteadyStateDetector(int maxPeriod, bool fastForward)
+{
+	this->maxPeriod = maxPeriod > 0 ? maxPeriod : 1;
+	this->fastForward = fastForward;
+	reset();
+}
+
+//Forgets every generation observed, to start watching another run
+void SteadyStateDetector::reset()
+{
+	verdict = Verdict::Running;
+	isVerdictUsed = false;
+	cycleStart = period = 0;
+	populations.clear();
+	firstGeneration = 0;
+	recentGenerations.clear();
+	recentHashes.assign(maxPeriod, 0);
+	lastRandomGeneration = -1;
+	haveSharksDiedOut = haveFishDiedOut = false;
+}
+
+//Looks at the given generation of a grid (rows and cols include the ghost cells, which are not looked at)
+//Generations have to be observed one after another, without any left out. randomSharkDeaths says whether sharks die
+//of random causes on the way to the next generation. Once a verdict is reached, the generations after it are ignored.
+void SteadyStateDetector::observe(int **grid, int rows, int cols, int generation, bool randomSharkDeaths)
+{
+	if (verdict != Verdict::Running)
+		return;
+
+	unsigned long long hash;
+	Population population;
+	hashGrid(grid, rows, cols, hash, population);
+	observe(hash, population, generation, randomSharkDeaths);
+}
+
+//Looks at a generation that has already been hashed (the sum of hashRow over its rows) and counted, the same way as
+//the observe above; this is how the grids that hash each row as they calculate it pass their generations on
+void SteadyStateDetector::observe(unsigned long long hash, Population population, int generation,
+	bool randomSharkDeaths)
+{
+	if (verdict != Verdict::Running)
+		return;
+
+	if (populations.empty())
+		firstGeneration = generation;
+	else
+	{
+		//The sharks of the generation before could have died at random on the way to this one
+		const Population &previous = populations.back();
+		if (randomSharkDeaths && previous.sharks > 0)
+			lastRandomGeneration = generation - 1;
+
+		if (population.sharks == 0 && previous.sharks > 0 && !haveSharksDiedOut)
+			std::cout << "Generation " << generation << ": the sharks have died out" << std::endl;
+		if (population.fish == 0 && previous.fish > 0 && !haveFishDiedOut)
+			std::cout << "Generation " << generation << ": the fish have died out" << std::endl;
+	}
+	haveSharksDiedOut = population.sharks == 0;
+	haveFishDiedOut = population.fish == 0;
+	populations.push_back(population);
+
+	if (population.sharks == 0 && population.fish == 0)
+	{
+		verdict = Verdict::Extinct;
+		cycleStart = generation;
+		period = 1;
+		std::cout << "Generation " << generation << ": there are no fish or sharks left" << std::endl;
+		return;
+	}
+
+	//A generation only repeats an earlier one if nothing random happened in between
+	auto earlier = recentGenerations.find(hash);
+	if (earlier != recentGenerations.end() && earlier->second > lastRandomGeneration)
+	{
+		const Population &earlierPopulation = populations[earlier->second - firstGeneration];
+		if (earlierPopulation.sharks == population.sharks && earlierPopulation.fish == population.fish)
+		{
+			verdict = Verdict::Cycle;
+			cycleStart = earlier->second;
+			period = generation - earlier->second;
+			std::cout << "Generation " << generation << " is the same as generation " << cycleStart
+				<< ": the grid repeats every " << period << " generations" << std::endl;
+			return;
+		}
+	}
+
+	//Remember this generation, forgetting the one maxPeriod generations back
+	int slot = (generation - firstGeneration) % maxPeriod;
+	if (generation - firstGeneration >= maxPeriod)
+	{
+		auto oldest = recentGenerations.find(recentHashes[slot]);
+		if (oldest != recentGenerations.end() && oldest->second == generation - maxPeriod)
+			recentGenerations.erase(oldest);
+	}
+	recentGenerations[hash] = generation;
+	recentHashes[slot] = hash;
+}
+
+//Returns how many of the generationsLeft generations of a run still have to be calculated, given what has been
+//found: none once everything is extinct, and only what's left after the whole cycles once the grid repeats (with
+//fastForward set), since the grid is then the same at the end either way. Says why when it cuts a run short.
+//A verdict is only acted on the first time this is called after it's reached.
+int SteadyStateDetector::skipAhead(int generationsLeft)
+{
+	if (verdict == Verdict::Running || isVerdictUsed)
+		return generationsLeft;
+	isVerdictUsed = true;
+
+	if (verdict == Verdict::Extinct)
+	{
+		if (generationsLeft > 0)
+			std::cout << "Stopping " << generationsLeft << " generations early, since nothing is left alive" << std::endl;
+		return 0;
+	}
+
+	if (!fastForward)
+		return generationsLeft;
+	int generationsToRun = generationsLeft % period;
+	if (generationsToRun < generationsLeft)
+		std::cout << "Skipping " << generationsLeft - generationsToRun << " generations of whole cycles, with "
+			<< generationsToRun << " left to run" << std::endl;
+	return generationsToRun;
+}
+
+SteadyStateDetector::Verdict SteadyStateDetector::getVerdict()
+{
+	return verdict;
+}
+
+//Returns the first generation of the cycle found (for Verdict::Cycle), or the generation everything was extinct by
+int SteadyStateDetector::getCycleStart()
+{
+	return cycleStart;
+}
+
+//Returns the number of generations the cycle found takes (1 once everything is extinct)
+int SteadyStateDetector::getPeriod()
+{
+	return period;
+}
+
+//Returns the number of sharks and fish in each generation observed, starting with the first one
+const std::vector<SteadyStateDetector::Population> &SteadyStateDetector::getPopulations()
+{
+	return populations;
+}
+
+//Returns the sum of the hashes of the fish and sharks in a row of a grid (cells includes the ghost cells, which are
+//left out, and row counts from 1 like the grid's rows); the rows' sums add up to the whole grid's hash in any order
+unsigned long long SteadyStateDetector::hashRow(const int *cells, int row, int cols)
+{
+	unsigned long long hash = 0;
+	long long rowStart = static_cast<long long>(row - 1) * (cols - 2) - 1;
+	for (int col = 1; col < cols - 1; ++col)
+	{
+		if (cells[col] != 0)
+			hash += hashCell(rowStart + col, cells[col]);
+	}
+	return hash;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Hashes every fish and shark in the grid by position and age, and counts them, in parallel
+//The cells' hashes are added up, so the order they're added in doesn't matter
+void SteadyStateDetector::hashGrid(int **grid, int rows, int cols, unsigned long long &outHash,
+	Population &outPopulation)
+{
+	unsigned long long hash = 0;
+	long long sharks = 0, fish = 0;
+
+#pragma omp parallel for reduction(+:hash, sharks, fish)
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		hash += hashRow(grid[row], row, cols);
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			fish += grid[row][col] > 0;
+			sharks += grid[row][col] < 0;
+		}
+	}
+
+	outHash = hash;
+	outPopulation.sharks = sharks;
+	outPopulation.fish = fish;
+}
+
+//Mixes a cell's index (row by row, without ghost cells) and value into 64 well spread bits (the splitmix64 finalizer)
+unsigned long long SteadyStateDetector::hashCell(long long cellIndex, int value)
+{
+	//Cell values are between -maxSharkAge and maxFishAge, so adding 32 makes them fit in 6 bits
+	unsigned long long bits = static_cast<unsigned long long>(cellIndex) * 64 + (value + 32);
+	bits += 0x9E3779B97F4A7C15ull;
+	bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ull;
+	bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBull;
+	return bits ^ (bits >> 31);
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include<unordered_map>
+#include<vector>
+
+/*Watches a grid generation by generation for runs that have settled, so they can stop (or skip ahead) instead of
+calculating generations whose outcome is already known:
+> extinction: once there are no fish and no sharks left, every generation after is all water
+> cycles: once the grid is exactly the same as it was a few generations before, it goes round the same generations
+  forever, as long as nothing random happens in between. The only random rule is the sharks' deaths from random
+  causes, so this applies when those are turned off (see Grid::setRandomSharkDeaths), or once the sharks have died out.
+
+Each generation is summed up as a hash of every fish's and shark's position and age (water adds nothing), along with
+the number of sharks and fish, which are kept for every generation. A generation whose hash and numbers match one of
+the last maxPeriod generations' is taken to repeat it. The hash is a sum of the cells' hashes, so it doesn't depend
+on the order they're added in: Grid and GridOMP add each row's up in the kernel (see hashRow), while the row is still
+in the cache, and hand the total to observe along with the counts. For the other grids, observe hashes the whole grid
+again once per generation.*/
+class SteadyStateDetector
+{
+public:
+	enum class Verdict { Running, Extinct, Cycle };
+
+	struct Population
+	{
+		long long sharks, fish;
+	};
+
+	SteadyStateDetector(int maxPeriod = 1000, bool fastForward = true);
+	void reset();
+	void observe(int **grid, int rows, int cols, int generation, bool randomSharkDeaths);
+	void observe(unsigned long long hash, Population population, int generation, bool randomSharkDeaths);
+	static unsigned long long hashRow(const int *cells, int row, int cols);
+	int skipAhead(int generationsLeft);
+	Verdict getVerdict();
+	int getCycleStart();
+	int getPeriod();
+	const std::vector<Population> &getPopulations();
+
+protected:
+	int maxPeriod;
+	bool fastForward;
+
+	Verdict verdict;
+	//Whether the verdict has been acted on by skipAhead yet
+	bool isVerdictUsed;
+	//For Verdict::Cycle: the first generation that repeats, and how many generations later it comes round again
+	int cycleStart, period;
+
+	//The number of sharks and fish in every generation observed, from firstGeneration on
+	std::vector<Population> populations;
+	int firstGeneration;
+	//The hashes of the last maxPeriod generations, and the generations they belong to
+	std::unordered_map<unsigned long long, int> recentGenerations;
+	std::vector<unsigned long long> recentHashes;
+	//The last generation that went on to the next one with random shark deaths, or -1 if none did
+	int lastRandomGeneration;
+	bool haveSharksDiedOut, haveFishDiedOut;
+
+	void hashGrid(int **grid, int rows, int cols, unsigned long long &outHash, Population &outPopulation);
+	static unsigned long long hashCell(long long cellIndex, int value);
+};
\ No newline at end of file
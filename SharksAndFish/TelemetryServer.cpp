@@ -0,0 +1,248 @@
+#include"stdafx.h"
+#include"TelemetryServer.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<sstream>
+
+#ifdef _WIN32
+//Keeps windows.h (which winsock2.h includes) from defining min and max macros
+#define NOMINMAX
+#include<winsock2.h>
+#include<ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET Socket;
+#define closeSocket closesocket
+#else
+#include<arpa/inet.h>
+#include<netinet/in.h>
+#include<sys/select.h>
+#include<sys/socket.h>
+#include<unistd.h>
+typedef int Socket;
+#define INVALID_SOCKET (-1)
+#define closeSocket close
+#endif
+
+//How long the server waits for a connection before checking whether it should stop, in milliseconds
+#define ACCEPT_TIMEOUT 200
+//How long the server waits for a client that has connected to send its request before giving up on it, in
+//milliseconds; browsers often open connections they only use later, or never
+#define REQUEST_TIMEOUT 1000
+
+//Starts the server on the given port, on localhost only
+//Frames are scaled down so that neither side is longer than maxFrameSize pixels
+TelemetryServer::TelemetryServer(int port, int maxFrameSize)
+{
+	this->port = port;
+	this->maxFrameSize = std::max(maxFrameSize, 1);
+
+	for (Snapshot &snapshot : snapshots)
+	{
+		snapshot.generation = -1;
+		snapshot.sharkCount = snapshot.fishCount = snapshot.waterCount = 0;
+		for (double &milliseconds : snapshot.phaseMilliseconds)
+			milliseconds = 0;
+		snapshot.frameWidth = snapshot.frameHeight = 0;
+	}
+	writeIndex = 0;
+	readIndex = 1;
+	latestIndex = 2;
+
+	isRunning = true;
+	isWatched = false;
+	serverThread = std::thread(&TelemetryServer::serve, this);
+}
+
+TelemetryServer::~TelemetryServer()
+{
+	isRunning = false;
+	serverThread.join();
+}
+
+//Makes a snapshot of the given grid (rows and cols include the ghost cells) and makes it the latest one, once a
+//client has connected; until then it does nothing
+//phaseMilliseconds holds how long each of the generation's phases took, in the order of TelemetryPhase
+void TelemetryServer::publish(int **grid, int rows, int cols, int generation, const double *phaseMilliseconds)
+{
+	if (!isWatched)
+		return;
+
+	Snapshot &snapshot = snapshots[writeIndex];
+	snapshot.generation = generation;
+	for (int phase = 0; phase < nTelemetryPhases; ++phase)
+		snapshot.phaseMilliseconds[phase] = phaseMilliseconds[phase];
+
+	//Every pixel covers a square of cellsPerPixel x cellsPerPixel cells
+	int nRows = rows - 2, nCols = cols - 2;
+	int cellsPerPixel = (std::max(nRows, nCols) + maxFrameSize - 1) / maxFrameSize;
+	snapshot.frameWidth = (nCols + cellsPerPixel - 1) / cellsPerPixel;
+	snapshot.frameHeight = (nRows + cellsPerPixel - 1) / cellsPerPixel;
+	frameCounts.assign(3 * snapshot.frameWidth * snapshot.frameHeight, 0);
+
+	//Count everything in one pass: the totals, and what's in each pixel
+	long long counts[3] = {};
+	for (int row = 1; row < rows - 1; ++row)
+	{
+		int *pixelCounts = frameCounts.data() + 3 * ((row - 1) / cellsPerPixel) * snapshot.frameWidth;
+		for (int col = 1; col < cols - 1; ++col)
+		{
+			int type = grid[row][col] == 0 ? 0 : (grid[row][col] > 0 ? 1 : 2);
+			++counts[type];
+			++pixelCounts[3 * ((col - 1) / cellsPerPixel) + type];
+		}
+	}
+	snapshot.waterCount = counts[0];
+	snapshot.fishCount = counts[1];
+	snapshot.sharkCount = counts[2];
+
+	const unsigned char shades[3] = { 255, 128, 0 };
+	snapshot.frame.resize(snapshot.frameWidth * snapshot.frameHeight);
+	for (size_t pixel = 0; pixel < snapshot.frame.size(); ++pixel)
+	{
+		const int *pixelCounts = frameCounts.data() + 3 * pixel;
+		int type = pixelCounts[1] > pixelCounts[0] ? 1 : 0;
+		if (pixelCounts[2] > pixelCounts[type])
+			type = 2;
+		snapshot.frame[pixel] = shades[type];
+	}
+
+	//Hand the snapshot over, and take whichever one was the latest to write the next one into
+	writeIndex = latestIndex.exchange(writeIndex | freshSnapshot) & ~freshSnapshot;
+}
+
+//======PRIVATE MEMBERS===========================================================================
+
+//Runs on the server thread: accepts connections on localhost one at a time and answers them, until the server is
+//destroyed
+void TelemetryServer::serve()
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+	Socket listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(static_cast<unsigned short>(port));
+
+	int reuseAddress = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress));
+	if (listenSocket == INVALID_SOCKET || bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+		|| listen(listenSocket, 4) != 0)
+	{
+		std::cout << "Could not start the telemetry server on port " << port << "!" << std::endl;
+		if (listenSocket != INVALID_SOCKET)
+			closeSocket(listenSocket);
+		isRunning = false;
+	}
+
+	while (isRunning)
+	{
+		//Wait for a connection, but not for too long, so the loop notices when it has to stop
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(listenSocket, &readSet);
+		timeval timeout = { 0, ACCEPT_TIMEOUT * 1000 };
+		if (select(static_cast<int>(listenSocket) + 1, &readSet, nullptr, nullptr, &timeout) <= 0)
+			continue;
+
+		Socket client = accept(listenSocket, nullptr, nullptr);
+		if (client == INVALID_SOCKET)
+			continue;
+		isWatched = true;
+
+		//Wait for the request, but not for too long, so a client that sends nothing can't hold the server up
+		FD_ZERO(&readSet);
+		FD_SET(client, &readSet);
+		timeout = { REQUEST_TIMEOUT / 1000, (REQUEST_TIMEOUT % 1000) * 1000 };
+		if (select(static_cast<int>(client) + 1, &readSet, nullptr, nullptr, &timeout) <= 0)
+		{
+			closeSocket(client);
+			continue;
+		}
+
+		//Read the request line; only GET is supported, and everything after the path is ignored
+		char request[1024];
+		int requestSize = recv(client, request, sizeof(request) - 1, 0);
+		if (requestSize > 0)
+		{
+			request[requestSize] = '\0';
+			std::istringstream requestLine(request);
+			std::string method, path;
+			requestLine >> method >> path;
+
+			std::string response = makeResponse(method == "GET" ? path : "");
+			for (size_t sent = 0; sent < response.size();)
+			{
+				int sentNow = send(client, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+				if (sentNow <= 0)
+					break;
+				sent += sentNow;
+			}
+		}
+		closeSocket(client);
+	}
+
+	if (listenSocket != INVALID_SOCKET)
+		closeSocket(listenSocket);
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+//Returns the latest snapshot, swapping the server's one for it if the simulation has published a new one since the
+//last time
+TelemetryServer::Snapshot &TelemetryServer::getLatestSnapshot()
+{
+	if (latestIndex.load() & freshSnapshot)
+		readIndex = latestIndex.exchange(readIndex) & ~freshSnapshot;
+	return snapshots[readIndex];
+}
+
+//Makes the full HTTP response for a request for the given path
+std::string TelemetryServer::makeResponse(const std::string &path)
+{
+	const Snapshot &snapshot = getLatestSnapshot();
+	std::ostringstream body;
+	std::string contentType = "application/json", status = "200 OK";
+
+	if (path == "/" || path == "/stats")
+	{
+		const char *phaseNames[nTelemetryPhases] = { "calculate", "copy", "analysis" };
+		body << "{\"generation\":" << snapshot.generation << ",\"sharks\":" << snapshot.sharkCount
+			<< ",\"fish\":" << snapshot.fishCount << ",\"water\":" << snapshot.waterCount << ",\"phaseMilliseconds\":{";
+		for (int phase = 0; phase < nTelemetryPhases; ++phase)
+			body << (phase > 0 ? "," : "") << "\"" << phaseNames[phase] << "\":" << snapshot.phaseMilliseconds[phase];
+		body << "},\"frameWidth\":" << snapshot.frameWidth << ",\"frameHeight\":" << snapshot.frameHeight << "}\n";
+	}
+	else if (path == "/frame" && snapshot.generation < 0)
+	{
+		//Nothing is published until the first request comes in (see publish), so there's no frame to send yet
+		status = "503 Service Unavailable";
+		contentType = "text/plain";
+		body << "No generation has been published yet; try again in a moment\n";
+	}
+	else if (path == "/frame")
+	{
+		contentType = "image/x-portable-graymap";
+		body << "P5\n" << snapshot.frameWidth << " " << snapshot.frameHeight << "\n255\n";
+		body.write(reinterpret_cast<const char*>(snapshot.frame.data()), snapshot.frame.size());
+	}
+	else
+	{
+		status = "404 Not Found";
+		contentType = "text/plain";
+		body << "Try /stats or /frame\n";
+	}
+
+	std::string bodyString = body.str();
+	std::ostringstream response;
+	response << "HTTP/1.0 " << status << "\r\nContent-Type: " << contentType << "\r\nContent-Length: "
+		<< bodyString.size() << "\r\nConnection: close\r\n\r\n" << bodyString;
+	return response.str();
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include<atomic>
+#include<string>
+#include<thread>
+#include<vector>
+
+//The phases of a generation that are timed, in the order they are passed to TelemetryServer::publish
+enum TelemetryPhase { calculatePhase, copyPhase, analysisPhase, nTelemetryPhases };
+
+/*A small HTTP server on localhost that lets you look at a running simulation without stopping it.
+It runs on a thread of its own and answers:
+/stats  - the latest generation's number, shark / fish / water counts and phase timings, as JSON
+/frame  - the latest generation, scaled down to at most maxFrameSize pixels a side, as a PGM image (black = shark,
+          grey = fish, white = water); each pixel shows whatever is most common in the cells it covers
+
+The simulation hands over snapshots through publish, and the server only ever reads the last complete one. Until the
+first request comes in, publish doesn't make any, so a server nobody looks at costs next to nothing; the answer to
+that first request is from before the simulation started (generation -1 for /stats, and 503 Service Unavailable for
+/frame), and the ones after it are up to date. A client that connects and then sends nothing is given up on after a
+second. There are three snapshot buffers: the one being written, the one being read, and the latest complete one in
+between, which the writer and the reader swap theirs with using a single atomic exchange. Neither side ever waits for
+the other, so a slow client can't hold up the simulation.*/
+class TelemetryServer
+{
+public:
+	TelemetryServer(int port = 8080, int maxFrameSize = 128);
+	~TelemetryServer();
+	void publish(int **grid, int rows, int cols, int generation, const double *phaseMilliseconds);
+
+protected:
+	struct Snapshot
+	{
+		int generation;
+		long long sharkCount, fishCount, waterCount;
+		double phaseMilliseconds[nTelemetryPhases];
+		int frameWidth, frameHeight;
+		std::vector<unsigned char> frame;
+	};
+
+	int port, maxFrameSize;
+	Snapshot snapshots[3];
+	//The index of the snapshot the simulation writes to, and of the one the server reads from
+	int writeIndex, readIndex;
+	//The index of the latest complete snapshot, plus freshSnapshot if the server hasn't picked it up yet
+	std::atomic<int> latestIndex;
+	static const int freshSnapshot = 4;
+	//Per-pixel cell counts (water, fish, shark) for the frame being made
+	std::vector<int> frameCounts;
+
+	std::thread serverThread;
+	std::atomic<bool> isRunning;
+	//Whether any client has connected yet
+	std::atomic<bool> isWatched;
+
+	void serve();
+	Snapshot &getLatestSnapshot();
+	std::string makeResponse(const std::string &path);
+};
\ No newline at end of file